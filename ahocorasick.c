@@ -0,0 +1,250 @@
+// ================================================================
+// AHO-CORASICK - Automaton for alternations of plain literals
+// ================================================================
+// This file is amalgamated into regex.c - do not compile separately
+//
+// cat|dog|bird|...: compiled as a program, every start position walks the
+// whole chain of OP_CHOICEs, so a blocklist of thousands of keywords costs
+// thousands of steps per byte.  Instead the literals go into a trie whose
+// failure links are resolved into a dense transition table, one row per
+// state and one column per byte class (each byte used by a literal, folded
+// under i, plus one class for every other byte), and the text is read once.
+// Each state knows the literal spelled by its path, if any, and the nearest
+// shorter suffix that is one, so every literal ending at a byte is found by
+// following those links from the longest down.
+//
+// Once a literal is found the leftmost match starts at or before it, and
+// no literal starting there or earlier can end more than max_length bytes
+// later, so the scan stops there.  Among literals at the leftmost start the
+// first alternative wins, as in the backtracker, or with
+// regex_leftmost_longest the longest one.
+
+typedef struct AhoCorasick {
+    int state_count;
+    int class_count;
+    uint8_t classes[256];  // Column of each byte; 0 for bytes no literal uses
+    int *table;            // state_count * class_count transitions, as row offsets
+    int match_row;         // Rows from here on belong to states where a literal ends
+    int *literal;          // Per state: alternative spelled by its path, or -1
+    int *output;           // Per state: longest proper suffix state with a literal, 0 if none
+    int *depth;            // Per state: length of its path
+    int literal_count;
+    int max_length;
+    int capture;           // (a|b|c): group 1 is the whole match
+    int longest;           // Leftmost-longest instead of leftmost-first
+} AhoCorasick;
+
+// Largest transition table built, in bytes; bigger sets use the VMs
+static const size_t aho_max_table_bytes = (size_t)64 << 20;
+
+static void aho_free(AhoCorasick *aho) {
+    if (!aho) return;
+    free(aho->table);
+    free(aho->literal);
+    free(aho->output);
+    free(aho->depth);
+    free(aho);
+}
+
+// Bytes of a literal alternative, or 0 if it is anything else
+static int aho_literal_length(ASTNode *node) {
+    if (node->type == AST_CHAR) return 1;
+    if (node->type != AST_SEQUENCE || node->data.sequence.child_count == 0) return 0;
+
+    for (int i = 0; i < node->data.sequence.child_count; i++) {
+        if (node->data.sequence.children[i]->type != AST_CHAR) return 0;
+    }
+    return node->data.sequence.child_count;
+}
+
+static unsigned char aho_literal_byte(ASTNode *node, int i, int flags) {
+    unsigned char c = node->type == AST_CHAR ? node->data.character : node->data.sequence.children[i]->data.character;
+    return (flags & 2) && c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+// Compile-time eligibility check and construction; NULL if not eligible
+static AhoCorasick* aho_build(ASTNode *ast, int flags) {
+    if (!ast) return NULL;
+
+    int capture = 0;
+    if (ast->type == AST_GROUP) {
+        ast = ast->data.group.content;
+        capture = 1;
+        if (!ast) return NULL;
+    }
+    if (ast->type != AST_ALTERNATION) return NULL;
+
+    int count = ast->data.alternation.alternative_count;
+    ASTNode **alternatives = ast->data.alternation.alternatives;
+    int total = 0;
+    for (int i = 0; i < count; i++) {
+        int length = aho_literal_length(alternatives[i]);
+        if (length == 0) return NULL;
+        total += length;
+    }
+
+    AhoCorasick *aho = calloc(1, sizeof(AhoCorasick));
+    aho->literal_count = count;
+    aho->capture = capture;
+
+    // Byte classes: letters share a column with their other case under i
+    for (int i = 0; i < count; i++) {
+        int length = aho_literal_length(alternatives[i]);
+        if (length > aho->max_length) aho->max_length = length;
+        for (int k = 0; k < length; k++) {
+            unsigned char c = aho_literal_byte(alternatives[i], k, flags);
+            if (!aho->classes[c]) aho->classes[c] = ++aho->class_count;
+        }
+    }
+    aho->class_count++;
+    if (flags & 2) {
+        for (int c = 'a'; c <= 'z'; c++) aho->classes[c - 'a' + 'A'] = aho->classes[c];
+    }
+
+    // Every state but the root is some literal's prefix, so total + 1 rows suffice
+    int max_states = total + 1;
+    size_t table_bytes = (size_t)max_states * (size_t)aho->class_count * sizeof(int);
+    if (table_bytes > aho_max_table_bytes) {
+        free(aho);
+        return NULL;
+    }
+    aho->table = malloc(table_bytes);
+    aho->literal = malloc(max_states * sizeof(int));
+    aho->output = calloc(max_states, sizeof(int));
+    aho->depth = malloc(max_states * sizeof(int));
+    int *fail = calloc(max_states, sizeof(int));
+
+    // Trie; -1 marks a missing child
+    memset(aho->table, 0xFF, (size_t)aho->class_count * sizeof(int));
+    aho->literal[0] = -1;
+    aho->depth[0] = 0;
+    aho->state_count = 1;
+    for (int i = 0; i < count; i++) {
+        int length = aho_literal_length(alternatives[i]);
+        int state = 0;
+        for (int k = 0; k < length; k++) {
+            int *next = &aho->table[state * aho->class_count + aho->classes[aho_literal_byte(alternatives[i], k, flags)]];
+            if (*next < 0) {
+                int child = aho->state_count++;
+                memset(&aho->table[child * aho->class_count], 0xFF, aho->class_count * sizeof(int));
+                aho->literal[child] = -1;
+                aho->depth[child] = k + 1;
+                *next = child;
+            }
+            state = *next;
+        }
+        // A repeated literal keeps its first alternative
+        if (aho->literal[state] < 0) aho->literal[state] = i;
+    }
+
+    // Breadth-first: a missing child becomes the failure state's transition
+    int *queue = malloc(aho->state_count * sizeof(int));
+    int head = 0, tail = 0;
+    queue[tail++] = 0;
+    while (head < tail) {
+        int state = queue[head++];
+        int *row = &aho->table[state * aho->class_count];
+        int *fail_row = &aho->table[fail[state] * aho->class_count];
+        for (int c = 0; c < aho->class_count; c++) {
+            if (row[c] < 0) {
+                row[c] = state == 0 ? 0 : fail_row[c];
+                continue;
+            }
+            int child = row[c];
+            fail[child] = state == 0 ? 0 : fail_row[c];
+            aho->output[child] = aho->literal[fail[child]] >= 0 ? fail[child] : aho->output[fail[child]];
+            queue[tail++] = child;
+        }
+    }
+    free(fail);
+
+    // Renumber so that states where some literal ends come last: the scan
+    // then needs one comparison per byte to know there is nothing to report
+    int *renumber = malloc(aho->state_count * sizeof(int));
+    int next = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 1) aho->match_row = next * aho->class_count;
+        for (int i = 0; i < aho->state_count; i++) {
+            int state = queue[i];
+            int reports = aho->literal[state] >= 0 || aho->output[state] > 0;
+            if (reports == pass) renumber[state] = next++;
+        }
+    }
+    free(queue);
+
+    int *table = malloc((size_t)aho->state_count * aho->class_count * sizeof(int));
+    int *literal = malloc(aho->state_count * sizeof(int));
+    int *output = malloc(aho->state_count * sizeof(int));
+    int *depth = malloc(aho->state_count * sizeof(int));
+    for (int state = 0; state < aho->state_count; state++) {
+        int to = renumber[state];
+        for (int c = 0; c < aho->class_count; c++) {
+            table[to * aho->class_count + c] = renumber[aho->table[state * aho->class_count + c]] * aho->class_count;
+        }
+        literal[to] = aho->literal[state];
+        output[to] = renumber[aho->output[state]];
+        depth[to] = aho->depth[state];
+    }
+    free(renumber);
+    free(aho->table);
+    free(aho->literal);
+    free(aho->output);
+    free(aho->depth);
+    aho->table = table;
+    aho->literal = literal;
+    aho->output = output;
+    aho->depth = depth;
+
+    return aho;
+}
+
+// Leftmost match at or after start_pos: 1 with its span, or 0.  With
+// match_start NULL the first literal found answers.
+static int aho_search(AhoCorasick *aho, LiteralPrefix *prefix, const char *text, int text_len, int start_pos,
+                      int *match_start, int *match_end) {
+    int best_start = -1, best_end = -1, best_literal = -1;
+    int limit = text_len;
+    const int *table = aho->table;
+    const uint8_t *classes = aho->classes;
+    int match_row = aho->match_row;
+    int row = 0;
+
+    for (int pos = start_pos; pos < limit; pos++) {
+        if (row == 0 && best_start < 0 && prefix) {
+            // Nothing in flight: the next match starts at a prefix occurrence
+            pos = prefix_find(prefix, text, text_len, pos);
+            if (pos < 0) break;
+        }
+        row = table[row + classes[(unsigned char)text[pos]]];
+        if (row < match_row) continue;
+
+        // Literals ending here, longest (leftmost) first
+        int state = row / aho->class_count;
+        int found = aho->literal[state] >= 0 ? state : aho->output[state];
+        for (; found > 0; found = aho->output[found]) {
+            if (!match_start) return 1;
+
+            int start = pos + 1 - aho->depth[found];
+            int literal = aho->literal[found];
+            if (best_start >= 0) {
+                if (start > best_start) break;
+                if (start == best_start && (aho->longest ? pos + 1 <= best_end : literal > best_literal)) continue;
+            }
+            best_start = start;
+            best_end = pos + 1;
+            best_literal = literal;
+            if (start + aho->max_length < limit) limit = start + aho->max_length;
+        }
+    }
+
+    if (best_start < 0) return 0;
+    *match_start = best_start;
+    *match_end = best_end;
+    return 1;
+}
+
+int regex_leftmost_longest(CompiledRegex *compiled, int longest) {
+    if (!compiled || !compiled->aho) return 0;
+    compiled->aho->longest = longest != 0;
+    return 1;
+}
@@ -0,0 +1,251 @@
+// ================================================================
+// BIT-PARALLEL NFA - Glushkov automaton in a single 64-bit word
+// ================================================================
+// This file is amalgamated into regex.c - do not compile separately
+//
+// Built from the AST for patterns with at most 64 character positions (each
+// CHAR, DOT or CHARSET leaf, after expanding {n,m}) and no assertions other
+// than a leading ^ and trailing $ outside multiline mode.  Bit p of the state
+// word is set when position p was the last one matched, so one input byte
+// costs a follow-set lookup plus an AND with the byte's position mask.
+// When every position is only followed by itself and/or the next position
+// (\d{3}-\d{4}, [A-Z]{2}\d+) the follow step is plain Shift-And arithmetic;
+// otherwise it is looked up eight bits of state at a time.
+
+typedef struct BitNFA {
+    uint64_t masks[256];      // Positions that accept each byte
+    uint64_t first;           // Positions that can begin a match
+    uint64_t last;            // Positions that can end a match
+    uint64_t forward;         // Shift-And: positions followed by the next position
+    uint64_t loop;            // Shift-And: positions followed by themselves
+    uint64_t (*follow)[256];  // Follow sets per state byte, NULL when Shift-And applies
+    int chunk_count;          // State bytes in use
+    int nullable;             // Empty string matches
+    int anchored_start;
+    int anchored_end;
+} BitNFA;
+
+typedef struct {
+    uint64_t masks[256];
+    uint64_t follow[64];
+    int position_count;
+    int flags;
+    int failed;
+} GlushkovBuilder;
+
+typedef struct {
+    uint64_t first;
+    uint64_t last;
+    int nullable;
+} GlushkovSet;
+
+static void glushkov_link(GlushkovBuilder *builder, uint64_t from, uint64_t to) {
+    for (int p = 0; p < builder->position_count; p++) {
+        if (from & ((uint64_t)1 << p)) builder->follow[p] |= to;
+    }
+}
+
+static GlushkovSet glushkov_concat(GlushkovBuilder *builder, GlushkovSet left, GlushkovSet right) {
+    glushkov_link(builder, left.last, right.first);
+
+    GlushkovSet result;
+    result.first = left.first | (left.nullable ? right.first : 0);
+    result.last = right.last | (right.nullable ? left.last : 0);
+    result.nullable = left.nullable && right.nullable;
+    return result;
+}
+
+static GlushkovSet glushkov_node(GlushkovBuilder *builder, ASTNode *node) {
+    GlushkovSet result = {0, 0, 1};
+    if (!node || builder->failed) return result;
+
+    switch (node->type) {
+        case AST_CHAR:
+        case AST_DOT:
+        case AST_CHARSET: {
+            if (builder->position_count >= 64) {
+                builder->failed = 1;
+                return result;
+            }
+
+            // Reuse the VM's byte test so flags behave identically
+            uint8_t set[32];
+            ast_byte_set(node, builder->flags, set);
+
+            int p = builder->position_count++;
+            for (int c = 0; c < 256; c++) {
+                if (set[c >> 3] & (1 << (c & 7))) builder->masks[c] |= (uint64_t)1 << p;
+            }
+
+            result.first = result.last = (uint64_t)1 << p;
+            result.nullable = 0;
+            return result;
+        }
+
+        case AST_SEQUENCE:
+            for (int i = 0; i < node->data.sequence.child_count; i++) {
+                result = glushkov_concat(builder, result, glushkov_node(builder, node->data.sequence.children[i]));
+            }
+            return result;
+
+        case AST_ALTERNATION:
+            result.nullable = 0;
+            for (int i = 0; i < node->data.alternation.alternative_count; i++) {
+                GlushkovSet alternative = glushkov_node(builder, node->data.alternation.alternatives[i]);
+                result.first |= alternative.first;
+                result.last |= alternative.last;
+                result.nullable |= alternative.nullable;
+            }
+            return result;
+
+        case AST_GROUP:
+            return glushkov_node(builder, node->data.group.content);
+
+        case AST_QUANTIFIER: {
+            ASTNode *target = node->data.quantifier.target;
+            int min_count = node->data.quantifier.min_count;
+            int max_count = node->data.quantifier.max_count;
+
+            // Same expansion as the compiler: required copies, then a looping
+            // copy ({n,}, *, +) or optional copies ({n,m}, ?)
+            if (max_count == -1) {
+                for (int rep = 0; rep < min_count - 1; rep++) {
+                    result = glushkov_concat(builder, result, glushkov_node(builder, target));
+                }
+                GlushkovSet loop = glushkov_node(builder, target);
+                glushkov_link(builder, loop.last, loop.first);
+                if (min_count == 0) loop.nullable = 1;
+                result = glushkov_concat(builder, result, loop);
+            } else {
+                for (int rep = 0; rep < min_count; rep++) {
+                    result = glushkov_concat(builder, result, glushkov_node(builder, target));
+                }
+                for (int rep = min_count; rep < max_count; rep++) {
+                    GlushkovSet optional = glushkov_node(builder, target);
+                    optional.nullable = 1;
+                    result = glushkov_concat(builder, result, optional);
+                }
+            }
+            return result;
+        }
+
+        default:
+            // Anchors and word boundaries only survive as the stripped outer ^/$
+            builder->failed = 1;
+            return result;
+    }
+}
+
+static void bitnfa_free(BitNFA *nfa) {
+    if (!nfa) return;
+    free(nfa->follow);
+    free(nfa);
+}
+
+// Compile-time eligibility check and construction; NULL if not eligible
+static BitNFA* bitnfa_build(ASTNode *ast, int flags) {
+    if (!ast) return NULL;
+
+    // Peel a leading ^ and trailing $ off the top-level sequence
+    ASTNode **children = &ast;
+    int child_count = 1;
+    if (ast->type == AST_SEQUENCE) {
+        children = ast->data.sequence.children;
+        child_count = ast->data.sequence.child_count;
+    }
+
+    int anchored_start = 0, anchored_end = 0;
+    if (child_count > 0 && children[0]->type == AST_ANCHOR_START) {
+        anchored_start = 1;
+        children++;
+        child_count--;
+    }
+    if (child_count > 0 && children[child_count - 1]->type == AST_ANCHOR_END) {
+        anchored_end = 1;
+        child_count--;
+    }
+    if ((anchored_start || anchored_end) && (flags & 8)) return NULL; // Line anchors need the VM
+
+    GlushkovBuilder *builder = calloc(1, sizeof(GlushkovBuilder));
+    builder->flags = flags;
+
+    GlushkovSet whole = {0, 0, 1};
+    for (int i = 0; i < child_count && !builder->failed; i++) {
+        whole = glushkov_concat(builder, whole, glushkov_node(builder, children[i]));
+    }
+    if (builder->failed) {
+        free(builder);
+        return NULL;
+    }
+
+    BitNFA *nfa = calloc(1, sizeof(BitNFA));
+    memcpy(nfa->masks, builder->masks, sizeof(nfa->masks));
+    nfa->first = whole.first;
+    nfa->last = whole.last;
+    nfa->nullable = whole.nullable;
+    nfa->anchored_start = anchored_start;
+    nfa->anchored_end = anchored_end;
+
+    // Shift-And applies when each follow set is within {p, p + 1}
+    int shift_and = 1;
+    for (int p = 0; p < builder->position_count; p++) {
+        uint64_t self = (uint64_t)1 << p;
+        uint64_t next = p < 63 ? self << 1 : 0;
+        if (builder->follow[p] & ~(self | next)) shift_and = 0;
+        if (builder->follow[p] & self) nfa->loop |= self;
+        if (builder->follow[p] & next) nfa->forward |= self;
+    }
+
+    if (!shift_and) {
+        nfa->chunk_count = (builder->position_count + 7) / 8;
+        nfa->follow = calloc(nfa->chunk_count, sizeof(*nfa->follow));
+        for (int chunk = 0; chunk < nfa->chunk_count; chunk++) {
+            for (int bits = 1; bits < 256; bits++) {
+                uint64_t follow = 0;
+                for (int i = 0; i < 8; i++) {
+                    int p = chunk * 8 + i;
+                    if ((bits & (1 << i)) && p < builder->position_count) follow |= builder->follow[p];
+                }
+                nfa->follow[chunk][bits] = follow;
+            }
+        }
+    }
+
+    free(builder);
+    return nfa;
+}
+
+static inline uint64_t bitnfa_step(BitNFA *nfa, uint64_t state) {
+    if (!nfa->follow) {
+        return ((state & nfa->forward) << 1) | (state & nfa->loop);
+    }
+    uint64_t follow = 0;
+    for (int chunk = 0; chunk < nfa->chunk_count; chunk++) {
+        follow |= nfa->follow[chunk][(state >> (chunk * 8)) & 0xff];
+    }
+    return follow;
+}
+
+// Unanchored yes/no search from start_pos
+static int bitnfa_search(BitNFA *nfa, LiteralPrefix *prefix, const char *text, int text_len, int start_pos) {
+    if (nfa->anchored_start && start_pos > 0) return 0;
+
+    // The empty match is available unless both anchors pin it to a non-empty text
+    if (nfa->nullable && (!(nfa->anchored_start && nfa->anchored_end) || text_len == 0)) return 1;
+
+    uint64_t state = 0;
+    for (int pos = start_pos; pos < text_len; pos++) {
+        if (!state && prefix) {
+            // Nothing in flight: the next match starts at a prefix occurrence
+            pos = prefix_find(prefix, text, text_len, pos);
+            if (pos < 0) return 0;
+        }
+        uint64_t seed = (!nfa->anchored_start || pos == 0) ? nfa->first : 0;
+        state = (bitnfa_step(nfa, state) | seed) & nfa->masks[(unsigned char)text[pos]];
+
+        if ((state & nfa->last) && (!nfa->anchored_end || pos + 1 == text_len)) return 1;
+        if (!state && nfa->anchored_start) return 0;
+    }
+
+    return 0;
+}
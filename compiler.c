@@ -53,18 +53,36 @@ void ensure_ast_capacity(CompiledRegex *regex, int additional) {
 // Helper function to emit instruction during AST compilation
 int emit_ast_instruction(CompiledRegex *regex, OpCode op) {
     ensure_ast_capacity(regex, 1);
+    memset(&regex->code[regex->code_len], 0, sizeof(Instruction));
     regex->code[regex->code_len].op = op;
     return regex->code_len++;
 }
 
-// Compile an AST node to bytecode
-void compile_ast_node(ASTNode *node, CompiledRegex *regex) {
+// Index of charset in the program's charset pool, adding it if no equal
+// class is there yet
+static int charset_pool_add(CompiledRegex *regex, const uint8_t *charset) {
+    for (int i = 0; i < regex->charset_count; i++) {
+        if (memcmp(regex->charsets[i], charset, 32) == 0) return i;
+    }
+    if (regex->charset_count == regex->charset_capacity) {
+        regex->charset_capacity = regex->charset_capacity ? regex->charset_capacity * 2 : 4;
+        regex->charsets = realloc(regex->charsets, regex->charset_capacity * sizeof(*regex->charsets));
+    }
+    memcpy(regex->charsets[regex->charset_count], charset, 32);
+    return regex->charset_count++;
+}
+
+// Compile an AST node to bytecode.  With reverse set, the code matches the
+// node's text right to left: sequences are emitted backwards, ^ and $ trade
+// places and groups capture nothing.
+void compile_ast_node(ASTNode *node, CompiledRegex *regex, int reverse) {
     if (!node) return;
     
     switch (node->type) {
         case AST_CHAR: {
             int pc = emit_ast_instruction(regex, OP_CHAR);
             regex->code[pc].c = node->data.character;
+            if (regex->flags & 2) regex->code[pc].c = (char)ascii_fold((unsigned char)node->data.character);
             break;
         }
         
@@ -74,27 +92,36 @@ void compile_ast_node(ASTNode *node, CompiledRegex *regex) {
         }
         
         case AST_CHARSET: {
+            uint8_t charset[32];
+            memcpy(charset, node->data.charset.charset, 32);
+            if (regex->flags & 2) charset_fold_case(charset);
             int pc = emit_ast_instruction(regex, OP_CHARSET);
-            memcpy(regex->code[pc].charset, node->data.charset.charset, 32);
+            regex->code[pc].charset = charset_pool_add(regex, charset);
             regex->code[pc].negate = node->data.charset.negate;
             break;
         }
         
         case AST_SEQUENCE: {
-            for (int i = 0; i < node->data.sequence.child_count; i++) {
-                compile_ast_node(node->data.sequence.children[i], regex);
+            int child_count = node->data.sequence.child_count;
+            for (int i = 0; i < child_count; i++) {
+                compile_ast_node(node->data.sequence.children[reverse ? child_count - 1 - i : i], regex, reverse);
             }
             break;
         }
         
         case AST_GROUP: {
+            if (reverse) {
+                compile_ast_node(node->data.group.content, regex, reverse);
+                break;
+            }
+            
             // Emit SAVE_GROUP start
             int start_pc = emit_ast_instruction(regex, OP_SAVE_GROUP);
             regex->code[start_pc].group_num = node->data.group.group_number;
             regex->code[start_pc].is_end = 0;
             
             // Compile group content
-            compile_ast_node(node->data.group.content, regex);
+            compile_ast_node(node->data.group.content, regex, reverse);
             
             // Emit SAVE_GROUP end
             int end_pc = emit_ast_instruction(regex, OP_SAVE_GROUP);
@@ -114,7 +141,7 @@ void compile_ast_node(ASTNode *node, CompiledRegex *regex) {
                 emit_ast_instruction(regex, OP_SAVE_POINTER);
                 
                 // Compile the target pattern
-                compile_ast_node(node->data.quantifier.target, regex);
+                compile_ast_node(node->data.quantifier.target, regex, reverse);
                 
                 emit_ast_instruction(regex, OP_ZERO_LENGTH);
                 
@@ -129,7 +156,7 @@ void compile_ast_node(ASTNode *node, CompiledRegex *regex) {
                 int loop_start = regex->code_len;
                 
                 // Compile the target pattern (required first match)
-                compile_ast_node(node->data.quantifier.target, regex);
+                compile_ast_node(node->data.quantifier.target, regex, reverse);
                 
                 // CHOICE: either continue to next instruction (exit) or jump to pattern again
                 int choice_pc = emit_ast_instruction(regex, OP_CHOICE);
@@ -144,7 +171,7 @@ void compile_ast_node(ASTNode *node, CompiledRegex *regex) {
                 int choice_pc = emit_ast_instruction(regex, OP_CHOICE);
                 
                 // Compile the target pattern
-                compile_ast_node(node->data.quantifier.target, regex);
+                compile_ast_node(node->data.quantifier.target, regex, reverse);
                 
                 // Update CHOICE to skip to here
                 regex->code[choice_pc].addr = regex->code_len - choice_pc;
@@ -156,7 +183,7 @@ void compile_ast_node(ASTNode *node, CompiledRegex *regex) {
                 
                 // Generate required matches (min_count times)
                 for (int rep = 0; rep < min_count; rep++) {
-                    compile_ast_node(node->data.quantifier.target, regex);
+                    compile_ast_node(node->data.quantifier.target, regex, reverse);
                 }
                 
                 // Handle additional optional matches
@@ -168,7 +195,7 @@ void compile_ast_node(ASTNode *node, CompiledRegex *regex) {
                     emit_ast_instruction(regex, OP_SAVE_POINTER);
                     
                     // The pattern to repeat
-                    compile_ast_node(node->data.quantifier.target, regex);
+                    compile_ast_node(node->data.quantifier.target, regex, reverse);
                     
                     emit_ast_instruction(regex, OP_ZERO_LENGTH);
                     
@@ -185,7 +212,7 @@ void compile_ast_node(ASTNode *node, CompiledRegex *regex) {
                         int choice_pc = emit_ast_instruction(regex, OP_CHOICE);
                         
                         // The optional pattern
-                        compile_ast_node(node->data.quantifier.target, regex);
+                        compile_ast_node(node->data.quantifier.target, regex, reverse);
                         
                         // Update CHOICE to skip to here
                         regex->code[choice_pc].addr = regex->code_len - choice_pc;
@@ -196,12 +223,12 @@ void compile_ast_node(ASTNode *node, CompiledRegex *regex) {
         }
         
         case AST_ANCHOR_START: {
-            emit_ast_instruction(regex, OP_ANCHOR_START);
+            emit_ast_instruction(regex, reverse ? OP_ANCHOR_END : OP_ANCHOR_START);
             break;
         }
         
         case AST_ANCHOR_END: {
-            emit_ast_instruction(regex, OP_ANCHOR_END);
+            emit_ast_instruction(regex, reverse ? OP_ANCHOR_START : OP_ANCHOR_END);
             break;
         }
         
@@ -226,7 +253,7 @@ void compile_ast_node(ASTNode *node, CompiledRegex *regex) {
                 int choice_pc = emit_ast_instruction(regex, OP_CHOICE);
                 
                 // Compile this alternative
-                compile_ast_node(node->data.alternation.alternatives[i], regex);
+                compile_ast_node(node->data.alternation.alternatives[i], regex, reverse);
                 
                 // Branch to end of alternation
                 branch_addrs[i] = emit_ast_instruction(regex, OP_BRANCH);
@@ -236,7 +263,7 @@ void compile_ast_node(ASTNode *node, CompiledRegex *regex) {
             }
             
             // Compile the last alternative (no CHOICE needed)
-            compile_ast_node(node->data.alternation.alternatives[alternative_count - 1], regex);
+            compile_ast_node(node->data.alternation.alternatives[alternative_count - 1], regex, reverse);
             
             // Update all BRANCH instructions to jump to here (end of alternation)
             for (int i = 0; i < alternative_count - 1; i++) {
@@ -249,14 +276,64 @@ void compile_ast_node(ASTNode *node, CompiledRegex *regex) {
     }
 }
 
-// Compile an AST to bytecode
-CompiledRegex* compile_ast(ASTNode *ast, int flags) {
+// Allocate an empty program
+static CompiledRegex* new_compiled_regex(int flags) {
     CompiledRegex *regex = malloc(sizeof(CompiledRegex));
     regex->code = malloc(sizeof(Instruction) * 16);
     regex->code_len = 0;
     regex->code_capacity = 16;
+    regex->charsets = NULL;
+    regex->charset_count = 0;
+    regex->charset_capacity = 0;
     regex->group_count = 0;
     regex->flags = flags;
+    regex->engine = REGEX_ENGINE_BACKTRACK;
+    regex->pinned = REGEX_MATCHER_NONE;
+    regex->dfa = NULL;
+    regex->dfa_cache_limit = REGEX_DFA_CACHE_LIMIT;
+    regex->full_dfa = NULL;
+    regex->bitnfa = NULL;
+    regex->onepass = NULL;
+    regex->jit = NULL;
+    regex->threaded = NULL;
+    regex->reverse = NULL;
+    regex->source = NULL;
+    regex->span_dfa = NULL;
+    regex->prefix = NULL;
+    regex->aho = NULL;
+    regex->substring = NULL;
+    regex->scratch = NULL;
+    regex->min_length = 0;
+    regex->max_length = -1;
+    memset(&regex->plan, 0, sizeof(RegexPlan));
+    return regex;
+}
+
+// The same pattern read right to left, for finding where a match starts
+// once its end is known
+static CompiledRegex* compile_reverse(ASTNode *ast, int flags) {
+    CompiledRegex *reverse = new_compiled_regex(flags);
+    compile_ast_node(ast, reverse, 1);
+    emit_ast_instruction(reverse, OP_MATCH);
+    reverse->group_count = 1;
+    return reverse;
+}
+
+// Only the span searches need the reverse program, so compile_regex leaves
+// it to be compiled from the source the first time one runs
+static CompiledRegex* regex_reverse(CompiledRegex *compiled) {
+    if (compiled->reverse) return compiled->reverse;
+    
+    int group_counter = 0;
+    ASTNode *ast = parse_pattern(compiled->source, &group_counter);
+    compiled->reverse = compile_reverse(ast, compiled->flags);
+    free_ast(ast);
+    return compiled->reverse;
+}
+
+// Compile an AST to bytecode, without the reverse program
+static CompiledRegex* compile_forward(ASTNode *ast, int flags) {
+    CompiledRegex *regex = new_compiled_regex(flags);
     
     // Emit SAVE_GROUP for group 0 (full match) start
     int start_pc = emit_ast_instruction(regex, OP_SAVE_GROUP);
@@ -264,7 +341,7 @@ CompiledRegex* compile_ast(ASTNode *ast, int flags) {
     regex->code[start_pc].is_end = 0;
     
     // Compile the AST
-    compile_ast_node(ast, regex);
+    compile_ast_node(ast, regex, 0);
     
     // Count groups by traversing the AST
     int max_group = count_groups(ast);
@@ -278,5 +355,16 @@ CompiledRegex* compile_ast(ASTNode *ast, int flags) {
     // Emit MATCH instruction
     emit_ast_instruction(regex, OP_MATCH);
     
+    plan_analyze(regex, ast);
+    plan_route(regex);
+    
     return regex;
-}
\ No newline at end of file
+}
+
+// Compile an AST to bytecode.  There is no source to compile the reverse
+// program from later, so it is built now with the rest.
+CompiledRegex* compile_ast(ASTNode *ast, int flags) {
+    CompiledRegex *regex = compile_forward(ast, flags);
+    regex->reverse = compile_reverse(ast, flags);
+    return regex;
+}
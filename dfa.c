@@ -0,0 +1,480 @@
+// ================================================================
+// LAZY DFA - On-demand determinization of the compiled bytecode
+// ================================================================
+// This file is amalgamated into regex.c - do not compile separately
+//
+// A DFA state is the ordered list of "pending" pcs that threads will resume
+// from, plus the class of the byte consumed to reach it.  The epsilon closure
+// of that list is only taken when the next byte is known, which lets anchors
+// and word boundaries be resolved exactly (left side from the state, right
+// side from the byte).  Transitions are built the first time they are needed
+// and cached on the CompiledRegex, so after warm-up each input byte costs a
+// single table lookup.  The cache is flushed when it grows past
+// dfa_cache_limit bytes; if that happens too often the caller falls back to
+// one of the VMs.
+//
+// The same machinery locates match spans for execute_regex_detailed: a
+// leftmost-first scan finds where the leftmost match ends, then the reverse
+// program, run right to left from there, finds the earliest position it can
+// start from.  The capture engines only have to run from that position.
+// When every match ends at the end of the text ($ outside multiline mode)
+// the forward scan is skipped and the reverse one starts there.
+
+// Class of the byte on one side of a position, for assertion checks
+enum {
+    DFA_CTX_BOUNDARY,  // Start or end of text
+    DFA_CTX_NEWLINE,
+    DFA_CTX_WORD,
+    DFA_CTX_OTHER
+};
+
+// How a closure treats MATCH; fixed per LazyDFA
+enum {
+    DFA_EARLIEST,        // Stop at the first match (yes/no search, full DFAs)
+    DFA_LEFTMOST_FIRST,  // Drop threads ranked below a match and stop seeding new starts
+    DFA_LONGEST          // Keep every thread, for the anchored reverse scan
+};
+
+// State flags used by span searches; part of a state's identity
+enum {
+    DFA_STATE_SEED = 1,     // A fresh thread starts at pc 0 before each byte
+    DFA_STATE_MATCHED = 2   // A match ended just before the byte consumed to get here
+};
+
+typedef struct DFAState {
+    struct DFAState *next[256];  // Lazily built transitions, NULL = unknown
+    struct DFAState *hash_next;  // Bucket chain
+    int context;                 // Class of the byte consumed to get here
+    int flags;                   // DFA_STATE_* bits, always 0 for DFA_EARLIEST
+    int id;                      // Dense index while building a full DFA, otherwise -1
+    int eof_match;               // -1 unknown, otherwise MATCH reachable at end of text
+    int count;
+    int pcs[];                   // Pending pcs in priority order
+} DFAState;
+
+typedef struct LazyDFA {
+    DFAState **buckets;
+    int bucket_count;
+    int state_count;
+    int memory_used;
+    int memory_limit;        // Copied from dfa_cache_limit at the start of each search
+    int kind;                // DFA_EARLIEST, DFA_LEFTMOST_FIRST or DFA_LONGEST
+    int uses_context;        // Program has ^ or \b, so states must remember the previous byte class
+    DFAState *start[4];      // Start state per context of the byte before start_pos
+
+    // Closure scratch, sized from code_len
+    int *stack;
+    int *sparse;
+    int *dense;
+    int dense_count;
+    int *closure;            // Consuming pcs reached by the closure, in priority order
+    int *pending;            // Pending list of the state being built
+    int matched;             // The last closure reached MATCH
+} LazyDFA;
+
+// Transition target meaning "a match ends before this byte"
+static DFAState dfa_match_state;
+
+// Give up after this many cache flushes in one search
+static const int dfa_max_flushes = 8;
+
+static int dfa_context_of(char c) {
+    if (c == '\n') return DFA_CTX_NEWLINE;
+    return is_word_char(c) ? DFA_CTX_WORD : DFA_CTX_OTHER;
+}
+
+static int dfa_assertion_holds(Instruction *inst, int left, int right, int flags) {
+    switch (inst->op) {
+        case OP_ANCHOR_START:
+            return left == DFA_CTX_BOUNDARY || ((flags & 8) && left == DFA_CTX_NEWLINE);
+        case OP_ANCHOR_END:
+            return right == DFA_CTX_BOUNDARY || ((flags & 8) && right == DFA_CTX_NEWLINE);
+        case OP_WORD_BOUNDARY:
+            return (left == DFA_CTX_WORD) != (right == DFA_CTX_WORD);
+        case OP_WORD_BOUNDARY_NEG:
+            return (left == DFA_CTX_WORD) == (right == DFA_CTX_WORD);
+        default:
+            return 1;
+    }
+}
+
+static LazyDFA* dfa_new(CompiledRegex *compiled, int kind) {
+    LazyDFA *dfa = malloc(sizeof(LazyDFA));
+    int code_len = compiled->code_len;
+    dfa->kind = kind;
+
+    dfa->bucket_count = 256;
+    dfa->buckets = calloc(dfa->bucket_count, sizeof(DFAState*));
+    dfa->state_count = 0;
+    dfa->memory_used = 0;
+    dfa->memory_limit = compiled->dfa_cache_limit;
+    memset(dfa->start, 0, sizeof(dfa->start));
+
+    dfa->uses_context = 0;
+    for (int pc = 0; pc < code_len; pc++) {
+        OpCode op = compiled->code[pc].op;
+        if (op == OP_ANCHOR_START || op == OP_WORD_BOUNDARY || op == OP_WORD_BOUNDARY_NEG) {
+            dfa->uses_context = 1;
+        }
+    }
+
+    dfa->stack = malloc((2 * code_len + 2) * sizeof(int));
+    dfa->sparse = calloc(code_len, sizeof(int));
+    dfa->dense = malloc(code_len * sizeof(int));
+    dfa->dense_count = 0;
+    dfa->closure = malloc(code_len * sizeof(int));
+    dfa->pending = malloc(code_len * sizeof(int));
+    return dfa;
+}
+
+static void dfa_flush(LazyDFA *dfa) {
+    for (int i = 0; i < dfa->bucket_count; i++) {
+        DFAState *state = dfa->buckets[i];
+        while (state) {
+            DFAState *next = state->hash_next;
+            free(state);
+            state = next;
+        }
+        dfa->buckets[i] = NULL;
+    }
+    dfa->state_count = 0;
+    dfa->memory_used = 0;
+    memset(dfa->start, 0, sizeof(dfa->start));
+}
+
+static void dfa_free(LazyDFA *dfa) {
+    if (!dfa) return;
+    dfa_flush(dfa);
+    free(dfa->buckets);
+    free(dfa->stack);
+    free(dfa->sparse);
+    free(dfa->dense);
+    free(dfa->closure);
+    free(dfa->pending);
+    free(dfa);
+}
+
+static unsigned int dfa_hash(int context, int flags, const int *pcs, int count) {
+    unsigned int hash = 2166136261u ^ (unsigned int)(context | flags << 2);
+    for (int i = 0; i < count; i++) {
+        hash = (hash ^ (unsigned int)pcs[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Find or create the state for (context, flags, pcs).  Returns NULL when the
+// cache is full; the caller flushes and retries.
+static DFAState* dfa_intern(LazyDFA *dfa, int context, int flags, const int *pcs, int count) {
+    if (!dfa->uses_context) context = DFA_CTX_BOUNDARY;
+
+    unsigned int bucket = dfa_hash(context, flags, pcs, count) % dfa->bucket_count;
+    for (DFAState *state = dfa->buckets[bucket]; state; state = state->hash_next) {
+        if (state->context == context && state->flags == flags && state->count == count &&
+            (count == 0 || memcmp(state->pcs, pcs, count * sizeof(int)) == 0)) {
+            return state;
+        }
+    }
+
+    int size = sizeof(DFAState) + count * sizeof(int);
+    if (dfa->memory_used + size > dfa->memory_limit && dfa->state_count > 0) {
+        return NULL;
+    }
+
+    DFAState *state = calloc(1, size);
+    state->context = context;
+    state->flags = flags;
+    state->id = -1;
+    state->eof_match = -1;
+    state->count = count;
+    if (count > 0) memcpy(state->pcs, pcs, count * sizeof(int));
+    state->hash_next = dfa->buckets[bucket];
+    dfa->buckets[bucket] = state;
+    dfa->state_count++;
+    dfa->memory_used += size;
+    return state;
+}
+
+// Epsilon closure of a state's pending list (plus a fresh thread at pc 0 when
+// seed is set) with the right-hand byte class known.  Fills dfa->closure with
+// consuming pcs in priority order and sets dfa->matched if MATCH is reached;
+// returns how many pcs, or -1 for a match in a DFA_EARLIEST automaton.
+static int dfa_closure(LazyDFA *dfa, CompiledRegex *compiled, DFAState *state, int seed, int right) {
+    int left = state->context;
+    int closure_count = 0;
+    dfa->dense_count = 0;
+    dfa->matched = 0;
+
+    for (int i = 0; i <= state->count; i++) {
+        int top = 0;
+        if (i < state->count) {
+            dfa->stack[top++] = state->pcs[i];
+        } else if (seed) {
+            dfa->stack[top++] = 0;
+        }
+
+        while (top > 0) {
+            int pc = dfa->stack[--top];
+            if (pc >= compiled->code_len) continue;
+
+            int index = dfa->sparse[pc];
+            if (index < dfa->dense_count && dfa->dense[index] == pc) continue;
+            dfa->sparse[pc] = dfa->dense_count;
+            dfa->dense[dfa->dense_count++] = pc;
+
+            Instruction *inst = &compiled->code[pc];
+            switch (inst->op) {
+                case OP_CHAR:
+                case OP_DOT:
+                case OP_CHARSET:
+                    dfa->closure[closure_count++] = pc;
+                    break;
+
+                case OP_MATCH:
+                    dfa->matched = 1;
+                    if (dfa->kind == DFA_EARLIEST) return -1;
+                    if (dfa->kind == DFA_LEFTMOST_FIRST) return closure_count;
+                    break;
+
+                case OP_CHOICE:
+                    dfa->stack[top++] = pc + inst->addr;
+                    dfa->stack[top++] = pc + 1;
+                    break;
+
+                case OP_BRANCH:
+                case OP_BRANCH_IF_NOT:
+                    dfa->stack[top++] = pc + inst->addr;
+                    break;
+
+                case OP_ANCHOR_START:
+                case OP_ANCHOR_END:
+                case OP_WORD_BOUNDARY:
+                case OP_WORD_BOUNDARY_NEG:
+                    if (dfa_assertion_holds(inst, left, right, compiled->flags)) {
+                        dfa->stack[top++] = pc + 1;
+                    }
+                    break;
+
+                case OP_FAIL:
+                    break;
+
+                default:
+                    // SAVE_GROUP, SAVE_POINTER, ZERO_LENGTH, RESTORE_POSITION
+                    dfa->stack[top++] = pc + 1;
+                    break;
+            }
+        }
+    }
+
+    return closure_count;
+}
+
+// Compute the transition of state on byte c.  Returns NULL if the cache is full.
+static DFAState* dfa_transition(LazyDFA *dfa, CompiledRegex *compiled, DFAState *state, int seed, unsigned char c) {
+    int closure_count = dfa_closure(dfa, compiled, state, seed, dfa_context_of((char)c));
+    if (closure_count < 0) {
+        state->next[c] = &dfa_match_state;
+        return &dfa_match_state;
+    }
+
+    int pending_count = 0;
+    for (int i = 0; i < closure_count; i++) {
+        int pc = dfa->closure[i];
+        if (inst_matches_char(compiled, &compiled->code[pc], (char)c)) {
+            dfa->pending[pending_count++] = pc + 1;
+        }
+    }
+
+    int flags = 0;
+    if (dfa->kind != DFA_EARLIEST) {
+        if (dfa->matched) flags |= DFA_STATE_MATCHED;
+        if (seed && !dfa->matched) flags |= DFA_STATE_SEED;
+    }
+
+    DFAState *next = dfa_intern(dfa, dfa_context_of((char)c), flags, dfa->pending, pending_count);
+    if (next) state->next[c] = next;
+    return next;
+}
+
+static int dfa_eof_match(LazyDFA *dfa, CompiledRegex *compiled, DFAState *state, int seed) {
+    if (state->eof_match < 0) {
+        dfa_closure(dfa, compiled, state, seed, DFA_CTX_BOUNDARY);
+        state->eof_match = dfa->matched;
+    }
+    return state->eof_match;
+}
+
+// Cached start state for a search whose first byte follows context
+static DFAState* dfa_start_state(LazyDFA *dfa, int context, int flags, const int *pcs, int count) {
+    if (!dfa->uses_context) context = DFA_CTX_BOUNDARY;
+
+    DFAState *state = dfa->start[context];
+    if (!state) {
+        state = dfa_intern(dfa, context, flags, pcs, count);
+        if (!state) {
+            dfa_flush(dfa);
+            state = dfa_intern(dfa, context, flags, pcs, count);
+        }
+        dfa->start[context] = state;
+    }
+    return state;
+}
+
+// Follow (or build) the transition of state on c.  Returns NULL if the cache
+// kept overflowing and the caller should use a VM instead.
+static DFAState* dfa_step(LazyDFA *dfa, CompiledRegex *compiled, DFAState *state, int seed, unsigned char c,
+                          int *flushes) {
+    DFAState *next = state->next[c];
+    if (next) return next;
+
+    next = dfa_transition(dfa, compiled, state, seed, c);
+    if (!next) {
+        // Cache full: keep only the current state and carry on
+        if (++*flushes > dfa_max_flushes) return NULL;
+        int count = state->count;
+        int state_context = state->context;
+        int state_flags = state->flags;
+        memcpy(dfa->pending, state->pcs, count * sizeof(int));
+        dfa_flush(dfa);
+        state = dfa_intern(dfa, state_context, state_flags, dfa->pending, count);
+        next = dfa_transition(dfa, compiled, state, seed, c);
+    }
+    return next;
+}
+
+// Unanchored yes/no search from start_pos.  Returns 1 on match, 0 on no
+// match, or -1 if the state cache kept overflowing and the caller should use
+// a VM instead.
+static int dfa_search(CompiledRegex *compiled, const char *text, int text_len, int start_pos) {
+    if (!compiled->dfa) compiled->dfa = dfa_new(compiled, DFA_EARLIEST);
+    LazyDFA *dfa = compiled->dfa;
+    dfa->memory_limit = compiled->dfa_cache_limit;
+
+    int context = start_pos > 0 ? dfa_context_of(text[start_pos - 1]) : DFA_CTX_BOUNDARY;
+    DFAState *state = dfa_start_state(dfa, context, 0, NULL, 0);
+    LiteralPrefix *prefix = prefix_skipping(compiled);
+
+    int flushes = 0;
+    for (int pos = start_pos; pos < text_len; pos++) {
+        if (prefix && state->count == 0) {
+            // No thread in flight: the next match begins at a prefix occurrence
+            int next_pos = prefix_find(prefix, text, text_len, pos);
+            if (next_pos < 0) return 0;
+            if (next_pos > pos) {
+                pos = next_pos;
+                state = dfa_start_state(dfa, dfa_context_of(text[pos - 1]), 0, NULL, 0);
+                // A line start after a final '\n' leaves only the empty match
+                if (pos == text_len) break;
+            }
+        }
+        DFAState *next = dfa_step(dfa, compiled, state, 1, (unsigned char)text[pos], &flushes);
+        if (!next) return -1;
+        if (next == &dfa_match_state) return 1;
+        state = next;
+    }
+
+    return dfa_eof_match(dfa, compiled, state, 1);
+}
+
+// Earliest start in [start_pos, end] of a match ending at end: the reverse
+// program run right to left from end.  With earliest set, any start will
+// do and the scan stops at the first one found.  -1 if there is none, -2
+// if the state cache kept overflowing.
+static int dfa_reverse_start(CompiledRegex *compiled, const char *text, int text_len, int start_pos, int end,
+                             int earliest) {
+    CompiledRegex *reverse = regex_reverse(compiled);
+    if (!reverse->dfa) reverse->dfa = dfa_new(reverse, DFA_LONGEST);
+    LazyDFA *rdfa = reverse->dfa;
+    rdfa->memory_limit = compiled->dfa_cache_limit;
+
+    // Reading right to left, the byte after end is on the left of the scan
+    int context = end < text_len ? dfa_context_of(text[end]) : DFA_CTX_BOUNDARY;
+    int first_pc = 0;
+    DFAState *state = dfa_start_state(rdfa, context, 0, &first_pc, 1);
+
+    int flushes = 0;
+    int start = -1;
+    int pos = end;
+    for (; pos > start_pos && state; pos--) {
+        DFAState *next = dfa_step(rdfa, reverse, state, 0, (unsigned char)text[pos - 1], &flushes);
+        if (!next) return -2;
+        if (next->flags & DFA_STATE_MATCHED) {
+            start = pos;
+            if (earliest) return start;
+        }
+        state = next->count > 0 ? next : NULL;
+    }
+    if (state) {
+        // Nothing is consumed past start_pos, but an assertion there still
+        // sees the byte before it
+        if (start_pos == 0) {
+            if (dfa_eof_match(rdfa, reverse, state, 0)) start = start_pos;
+        } else {
+            dfa_closure(rdfa, reverse, state, 0, dfa_context_of(text[start_pos - 1]));
+            if (rdfa->matched) start = start_pos;
+        }
+    }
+    return start;
+}
+
+// Leftmost-first match span from start_pos, found without running a VM:
+// a forward scan for the end, then the reverse program anchored at that end
+// for the earliest start.  Returns 1 and fills match_start/match_end, 0 if
+// nothing matches, or -1 if a state cache kept overflowing.
+static int dfa_search_span(CompiledRegex *compiled, const char *text, int text_len, int start_pos,
+                           int *match_start, int *match_end) {
+    if (!compiled->span_dfa) compiled->span_dfa = dfa_new(compiled, DFA_LEFTMOST_FIRST);
+    LazyDFA *dfa = compiled->span_dfa;
+    dfa->memory_limit = compiled->dfa_cache_limit;
+
+    // Phase one: the forward scan keeps going after the first match until
+    // every thread that could still beat it has died
+    int context = start_pos > 0 ? dfa_context_of(text[start_pos - 1]) : DFA_CTX_BOUNDARY;
+    DFAState *state = dfa_start_state(dfa, context, DFA_STATE_SEED, NULL, 0);
+    LiteralPrefix *prefix = prefix_skipping(compiled);
+
+    int flushes = 0;
+    int end = -1;
+    for (int pos = start_pos; pos < text_len && state; pos++) {
+        if (prefix && end < 0 && state->count == 0 && state->flags == DFA_STATE_SEED) {
+            int next_pos = prefix_find(prefix, text, text_len, pos);
+            if (next_pos < 0) return 0;
+            if (next_pos > pos) {
+                pos = next_pos;
+                state = dfa_start_state(dfa, dfa_context_of(text[pos - 1]), DFA_STATE_SEED, NULL, 0);
+                if (pos == text_len) break;
+            }
+        }
+        DFAState *next = dfa_step(dfa, compiled, state, state->flags & DFA_STATE_SEED, (unsigned char)text[pos], &flushes);
+        if (!next) return -1;
+        if (next->flags & DFA_STATE_MATCHED) end = pos;
+        state = next->count > 0 || (next->flags & DFA_STATE_SEED) ? next : NULL;
+    }
+    if (state && dfa_eof_match(dfa, compiled, state, state->flags & DFA_STATE_SEED)) end = text_len;
+    if (end < 0) return 0;
+
+    // Phase two: the leftmost match ending there starts at the earliest
+    // position the reverse program reaches, scanning back from end
+    int start = dfa_reverse_start(compiled, text, text_len, start_pos, end, 0);
+    if (start < 0) return -1;
+
+    *match_start = start;
+    *match_end = end;
+    return 1;
+}
+
+// Leftmost match of a pattern whose matches all end at text_len ($ outside
+// multiline mode): only the reverse scan is needed, and it reads no further
+// back than the match.  With match_start NULL it stops at the first start
+// found.  Same results as dfa_search_span.
+static int dfa_search_from_end(CompiledRegex *compiled, const char *text, int text_len, int start_pos,
+                               int *match_start, int *match_end) {
+    int start = dfa_reverse_start(compiled, text, text_len, start_pos, text_len, match_start == NULL);
+    if (start == -2) return -1;
+    if (start < 0) return 0;
+
+    if (match_start) {
+        *match_start = start;
+        *match_end = text_len;
+    }
+    return 1;
+}
@@ -1,7 +1,8 @@
 
 static int execute(CompiledRegex *compiled, VM *vm) {
     int instruction_count = 0;
-    const int max_instructions = 100000;
+    // The visited bitset already bounds the work, so it needs no cutoff
+    const int max_instructions = vm->visited || vm->visited_blocks ? INT_MAX : 100000;
 
     while (vm->pc < compiled->code_len && instruction_count < max_instructions) {
         instruction_count++;
@@ -18,10 +19,11 @@ static int execute(CompiledRegex *compiled, VM *vm) {
                 char text_char = vm->text[vm->pos];
                 char pattern_char = inst->c;
 
-                // Check for match (case sensitive or insensitive)
+                // Check for match (case sensitive or insensitive); under i
+                // the pattern character is already lower case
                 int char_matches = 0;
                 if (vm->flags & 2) { // Case insensitive flag 'i'
-                    char_matches = (tolower(text_char) == tolower(pattern_char));
+                    char_matches = (ascii_fold((unsigned char)text_char) == (unsigned char)pattern_char);
                 } else {
                     char_matches = (text_char == pattern_char);
                 }
@@ -68,24 +70,10 @@ static int execute(CompiledRegex *compiled, VM *vm) {
                 char test_ch = vm->text[vm->pos];
                 int matches = 0;
 
-                // Check direct character match
+                // Check direct character match; under i the class already
+                // holds both cases of its letters
                 int bit = (unsigned char)test_ch;
-                matches = (inst->charset[bit / 8] & (1 << (bit % 8))) != 0;
-
-                // If case insensitive flag is set and no match yet, try opposite case
-                if (!matches && (vm->flags & 2)) { // Case insensitive flag 'i'
-                    char opposite_case;
-                    if (islower(test_ch)) {
-                        opposite_case = toupper(test_ch);
-                    } else if (isupper(test_ch)) {
-                        opposite_case = tolower(test_ch);
-                    } else {
-                        opposite_case = test_ch; // No case change for non-letters
-                    }
-
-                    bit = (unsigned char)opposite_case;
-                    matches = (inst->charset[bit / 8] & (1 << (bit % 8))) != 0;
-                }
+                matches = (compiled->charsets[inst->charset][bit / 8] & (1 << (bit % 8))) != 0;
 
                 // Apply negation if needed
                 if (inst->negate) {
@@ -104,6 +92,16 @@ static int execute(CompiledRegex *compiled, VM *vm) {
                 break;
 
             case OP_CHOICE:
+                if (vm->visited || vm->visited_blocks) {
+                    // Captures never affect whether the rest of the program
+                    // matches, so a state seen before (from this or an earlier
+                    // start position) has either failed already or is being
+                    // re-entered through an empty loop iteration
+                    if (vm_visit(vm, vm->pc, vm->pos, vm->last_operation_success != 0)) {
+                        if (!pop_choice(vm)) return 0;
+                        continue;
+                    }
+                }
                 push_choice(vm, vm->pc + inst->addr);
                 vm->pc++;
                 break;
@@ -121,32 +119,20 @@ static int execute(CompiledRegex *compiled, VM *vm) {
                 }
                 break;
 
-            case OP_SAVE_POINTER: {
+            case OP_SAVE_POINTER:
                 // Push current position to integer data stack
-                IntStack *new_stack = int_stack_push(vm->data_stack, vm->pos);
-                int_stack_release(vm->data_stack);
-                vm->data_stack = new_stack;
+                vm_push_position(vm, vm->pos);
                 vm->pc++;
                 break;
-            }
 
-            case OP_RESTORE_POSITION: {
+            case OP_RESTORE_POSITION:
                 // Pop position from integer data stack
-                int saved_pos;
-                IntStack *new_stack = int_stack_pop(vm->data_stack, &saved_pos);
-                vm->pos = saved_pos;
-                int_stack_release(vm->data_stack);
-                vm->data_stack = new_stack;
+                vm->pos = vm_pop_position(vm);
                 vm->pc++;
                 break;
-            }
 
             case OP_SAVE_GROUP:
-                if (inst->is_end) {
-                    vm->group_ends[inst->group_num] = vm->pos;
-                } else {
-                    vm->group_starts[inst->group_num] = vm->pos;
-                }
+                vm_save_group(vm, inst->group_num, inst->is_end, vm->pos);
                 vm->pc++;
                 break;
 
@@ -0,0 +1,209 @@
+// ================================================================
+// FULL DFA - Ahead-of-time determinization and minimization
+// ================================================================
+// This file is amalgamated into regex.c - do not compile separately
+//
+// Explores every state of the lazy DFA (dfa.c) up front, minimizes the result
+// with Moore partition refinement and stores it as a dense state x 256 table.
+// Searching is then one table load per byte with no allocation.  Building
+// gives up, leaving full_dfa NULL, once more than max_states states appear.
+
+static void full_dfa_free(FullDFA *full) {
+    if (!full) return;
+    free(full->table);
+    free(full->eof_match);
+    free(full);
+}
+
+// Merge equivalent states.  class_of starts as the accepting partition and
+// ends as the minimal state numbering; returns the number of classes.
+static int full_dfa_minimize(int state_count, const int *table, int *class_of) {
+    int *next_class = malloc(state_count * sizeof(int));
+    int *buckets = malloc(2 * state_count * sizeof(int));
+    int class_count = 0;  // Unknown for the initial partition, so refine at least once
+
+    for (;;) {
+        int new_count = 0;
+        for (int i = 0; i < 2 * state_count; i++) buckets[i] = -1;
+
+        for (int s = 0; s < state_count; s++) {
+            const int *row = &table[s * 256];
+            unsigned int hash = 2166136261u ^ (unsigned int)class_of[s];
+            for (int c = 0; c < 256; c++) {
+                hash = (hash ^ (unsigned int)class_of[row[c]]) * 16777619u;
+            }
+
+            // Open addressing over states with the same signature
+            unsigned int slot = hash % (2 * state_count);
+            for (;;) {
+                int other = buckets[slot];
+                if (other < 0) {
+                    buckets[slot] = s;
+                    next_class[s] = new_count++;
+                    break;
+                }
+
+                const int *other_row = &table[other * 256];
+                int same = class_of[other] == class_of[s];
+                for (int c = 0; same && c < 256; c++) {
+                    same = class_of[other_row[c]] == class_of[row[c]];
+                }
+                if (same) {
+                    next_class[s] = next_class[other];
+                    break;
+                }
+                slot = (slot + 1) % (2 * state_count);
+            }
+        }
+
+        memcpy(class_of, next_class, state_count * sizeof(int));
+        if (new_count == class_count) break;
+        class_count = new_count;
+    }
+
+    free(next_class);
+    free(buckets);
+    return class_count;
+}
+
+// Build the complete DFA for an unanchored search.  Returns NULL when the
+// pattern needs more than max_states states.
+static FullDFA* full_dfa_build(CompiledRegex *compiled, int max_states) {
+    LazyDFA *dfa = dfa_new(compiled, DFA_EARLIEST);
+    dfa->memory_limit = INT_MAX;
+
+    DFAState **states = malloc((max_states + 1) * sizeof(DFAState*));
+    int state_count = 0;
+    int start_ids[4] = {0, 0, 0, 0};
+    int failed = 0;
+
+    int context_count = dfa->uses_context ? 4 : 1;
+    for (int context = 0; context < context_count; context++) {
+        DFAState *start = dfa_intern(dfa, context, 0, NULL, 0);
+        if (start->id < 0) {
+            start->id = state_count;
+            states[state_count++] = start;
+        }
+        start_ids[context] = start->id;
+    }
+
+    // Breadth-first exploration; transitions to dfa_match_state are recorded
+    // as -1 and patched to the match state below
+    int *raw = NULL;
+    for (int i = 0; i < state_count && !failed; i++) {
+        raw = realloc(raw, (i + 1) * 256 * sizeof(int));
+        for (int c = 0; c < 256; c++) {
+            DFAState *next = dfa_transition(dfa, compiled, states[i], 1, (unsigned char)c);
+            if (next == &dfa_match_state) {
+                raw[i * 256 + c] = -1;
+                continue;
+            }
+            if (next->id < 0) {
+                if (state_count >= max_states) {
+                    failed = 1;
+                    break;
+                }
+                next->id = state_count;
+                states[state_count++] = next;
+            }
+            raw[i * 256 + c] = next->id;
+        }
+    }
+
+    FullDFA *full = NULL;
+    if (!failed) {
+        // One extra absorbing state for "match found"
+        int match_id = state_count;
+        int total = state_count + 1;
+        int *table = malloc(total * 256 * sizeof(int));
+        int *class_of = malloc(total * sizeof(int));
+
+        for (int s = 0; s < state_count; s++) {
+            for (int c = 0; c < 256; c++) {
+                int target = raw[s * 256 + c];
+                table[s * 256 + c] = target < 0 ? match_id : target;
+            }
+            class_of[s] = dfa_eof_match(dfa, compiled, states[s], 1);
+        }
+        for (int c = 0; c < 256; c++) table[match_id * 256 + c] = match_id;
+        class_of[match_id] = 2;
+
+        int class_count = full_dfa_minimize(total, table, class_of);
+
+        full = malloc(sizeof(FullDFA));
+        full->state_count = class_count;
+        full->table = malloc(class_count * 256 * sizeof(int));
+        full->eof_match = malloc(class_count);
+        full->uses_context = dfa->uses_context;
+        full->match_state = class_of[match_id];
+        for (int context = 0; context < 4; context++) {
+            full->start[context] = class_of[start_ids[context < context_count ? context : 0]];
+        }
+        for (int s = 0; s < total; s++) {
+            int id = class_of[s];
+            for (int c = 0; c < 256; c++) {
+                full->table[id * 256 + c] = class_of[table[s * 256 + c]];
+            }
+            full->eof_match[id] = s == match_id ? 1 : (uint8_t)states[s]->eof_match;
+        }
+
+        // A state that only loops to itself and never accepts ends the search early
+        full->dead_state = -1;
+        for (int id = 0; id < class_count && full->dead_state < 0; id++) {
+            int dead = !full->eof_match[id] && id != full->match_state;
+            for (int c = 0; dead && c < 256; c++) {
+                dead = full->table[id * 256 + c] == id;
+            }
+            if (dead) full->dead_state = id;
+        }
+
+        free(table);
+        free(class_of);
+    }
+
+    free(raw);
+    free(states);
+    dfa_free(dfa);
+    return full;
+}
+
+// Start state for a search whose first byte is text[pos]
+static int full_dfa_start(FullDFA *full, const char *text, int pos) {
+    if (!full->uses_context || pos == 0) return full->start[DFA_CTX_BOUNDARY];
+    return full->start[dfa_context_of(text[pos - 1])];
+}
+
+// Unanchored yes/no search: a single table walk
+static int full_dfa_search(FullDFA *full, LiteralPrefix *prefix, const char *text, int text_len, int start_pos) {
+    int state = full_dfa_start(full, text, start_pos);
+    const int *table = full->table;
+
+    for (int pos = start_pos; pos < text_len; pos++) {
+        if (prefix && state == full_dfa_start(full, text, pos)) {
+            // Back at the start: the next match begins at a prefix occurrence
+            int next_pos = prefix_find(prefix, text, text_len, pos);
+            if (next_pos < 0) return 0;
+            if (next_pos > pos) {
+                pos = next_pos;
+                state = full_dfa_start(full, text, pos);
+                // A line start after a final '\n' leaves only the empty match
+                if (pos == text_len) break;
+            }
+        }
+        state = table[state * 256 + (unsigned char)text[pos]];
+        if (state == full->match_state) return 1;
+        if (state == full->dead_state) return 0;
+    }
+
+    return full->eof_match[state];
+}
+
+CompiledRegex* compile_regex_dfa(const char *pattern, int flags, int max_states) {
+    CompiledRegex *compiled = compile_regex(pattern, flags);
+    if (!compiled) return NULL;
+
+    // Falls back to the lazy DFA and VMs when the limit is exceeded
+    compiled->full_dfa = full_dfa_build(compiled, max_states > 0 ? max_states : REGEX_FULL_DFA_MAX_STATES);
+    plan_route(compiled);
+    return compiled;
+}
@@ -0,0 +1,498 @@
+// ================================================================
+// JIT - Native x86-64 code for the backtracking VM (Linux only)
+// ================================================================
+// This file is amalgamated into regex.c - do not compile separately
+//
+// regex_jit_compile translates the Instruction array into machine code in
+// mmap'd memory.  The generated function runs one start position with the
+// same semantics as execute() including the visited bitset: OP_CHAR and
+// OP_DOT become byte compares, OP_CHARSET a bit test against a 256-bit table
+// stored after the code, and CHOICE/BRANCH become real jumps.  Backtracking
+// uses a heap stack of 16-byte entries:
+//
+//   choice:  [resume address][pos << 1 | last_operation_success]
+//   undo:    [0][slot << 32 | old capture value]
+//
+// Register use inside the generated code:
+//   rdi text   rsi text_len   rdx pos   rcx visited   r8 capture slots
+//   r9 stack top   r10 stack limit   r12 text_len + 1   ebx last_operation_success
+//   rax, r11 scratch
+//
+// When the stack fills up the function returns -1; jit_execute retries with
+// a bigger stack and finally hands the search back to the interpreter.
+
+#if defined(__x86_64__) && defined(__linux__) && !defined(REGEX_NO_JIT)
+
+#include <sys/mman.h>
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS 0x20  // Linux value, hidden by strict -std=c11
+#endif
+
+typedef int (*RegexJitFunction)(const char *text, long text_len, long pos, uint8_t *visited,
+                                int *caps, uint64_t *stack, uint64_t *stack_end);
+
+typedef struct RegexJit {
+    void *memory;
+    size_t size;
+    RegexJitFunction run;
+} RegexJit;
+
+// Stack entries beyond this make jit_execute give up and use execute()
+static const int jit_max_stack_entries = 1 << 22;
+
+// Labels past the per-pc ones
+enum {
+    JIT_LABEL_FAIL,
+    JIT_LABEL_UNDO,
+    JIT_LABEL_OVERFLOW,
+    JIT_LABEL_NO_MATCH,
+    JIT_LABEL_WORD_TABLE,
+    JIT_LABEL_COUNT
+};
+
+typedef struct {
+    uint8_t *buf;
+    int len;
+    int capacity;
+    int *labels;         // Code offset per label, -1 while unknown
+    int label_count;
+    int *fixups;         // Pairs of (offset of a rel32 field, label)
+    int fixup_count;
+    int fixup_capacity;
+    int code_len;        // First special label
+} JitAssembler;
+
+static void jit_bytes(JitAssembler *as, const uint8_t *bytes, int count) {
+    while (as->len + count > as->capacity) {
+        as->capacity *= 2;
+        as->buf = realloc(as->buf, as->capacity);
+    }
+    memcpy(as->buf + as->len, bytes, count);
+    as->len += count;
+}
+
+#define JIT_EMIT(as, ...) do { \
+    const uint8_t jit_code_[] = {__VA_ARGS__}; \
+    jit_bytes(as, jit_code_, sizeof(jit_code_)); \
+} while (0)
+
+static void jit_imm32(JitAssembler *as, int32_t value) {
+    uint8_t bytes[4];
+    memcpy(bytes, &value, 4);
+    jit_bytes(as, bytes, 4);
+}
+
+// rel32 field pointing at label, patched once every label is placed
+static void jit_rel32(JitAssembler *as, int label) {
+    if (as->fixup_count >= as->fixup_capacity) {
+        as->fixup_capacity *= 2;
+        as->fixups = realloc(as->fixups, 2 * as->fixup_capacity * sizeof(int));
+    }
+    as->fixups[2 * as->fixup_count] = as->len;
+    as->fixups[2 * as->fixup_count + 1] = label;
+    as->fixup_count++;
+    jit_imm32(as, 0);
+}
+
+static int jit_special(JitAssembler *as, int which) {
+    return as->code_len + which;
+}
+
+static void jit_jmp(JitAssembler *as, int label) {
+    JIT_EMIT(as, 0xE9);
+    jit_rel32(as, label);
+}
+
+// Conditional jump; cc is the low nibble of the 0F 8x opcode
+enum { JIT_CC_B = 0x2, JIT_CC_AE = 0x3, JIT_CC_E = 0x4, JIT_CC_NE = 0x5, JIT_CC_A = 0x7 };
+
+static void jit_jcc(JitAssembler *as, int cc, int label) {
+    JIT_EMIT(as, 0x0F, 0x80 | cc);
+    jit_rel32(as, label);
+}
+
+static int jit_new_label(JitAssembler *as) {
+    as->labels = realloc(as->labels, (as->label_count + 1) * sizeof(int));
+    as->labels[as->label_count] = -1;
+    return as->label_count++;
+}
+
+static void jit_place(JitAssembler *as, int label) {
+    as->labels[label] = as->len;
+}
+
+// Function epilogue: restore callee-saved registers and return eax
+static void jit_return(JitAssembler *as, int32_t value) {
+    JIT_EMIT(as, 0xB8);              // mov eax, value
+    jit_imm32(as, value);
+    JIT_EMIT(as, 0x41, 0x5C,         // pop r12
+             0x5B,                   // pop rbx
+             0xC3);                  // ret
+}
+
+// Fail unless rdx < rsi (a byte is left to consume)
+static void jit_need_byte(JitAssembler *as) {
+    JIT_EMIT(as, 0x48, 0x39, 0xF2);  // cmp rdx, rsi
+    jit_jcc(as, JIT_CC_AE, jit_special(as, JIT_LABEL_FAIL));
+}
+
+// Test byte [rdi + rdx] (or the one before it) against the table at label,
+// leaving the result in CF; jumps to fail_label when clear unless it is -1
+static void jit_test_table(JitAssembler *as, int label, int previous_byte, int fail_label) {
+    if (previous_byte) {
+        JIT_EMIT(as, 0x0F, 0xB6, 0x44, 0x17, 0xFF);  // movzx eax, byte [rdi + rdx - 1]
+    } else {
+        JIT_EMIT(as, 0x0F, 0xB6, 0x04, 0x17);        // movzx eax, byte [rdi + rdx]
+    }
+    JIT_EMIT(as, 0x0F, 0xA3, 0x05);                  // bt [rip + table], eax
+    jit_rel32(as, label);
+    if (fail_label >= 0) jit_jcc(as, JIT_CC_AE, fail_label);  // CF clear: not in table
+}
+
+static void jit_consumed(JitAssembler *as) {
+    JIT_EMIT(as, 0x48, 0xFF, 0xC2);                  // inc rdx
+    JIT_EMIT(as, 0xBB, 0x01, 0x00, 0x00, 0x00);      // mov ebx, 1
+}
+
+// Jump to the overflow exit unless one more 16-byte entry fits
+static void jit_check_stack(JitAssembler *as) {
+    JIT_EMIT(as, 0x4D, 0x39, 0xD1);                  // cmp r9, r10
+    jit_jcc(as, JIT_CC_A, jit_special(as, JIT_LABEL_OVERFLOW));
+}
+
+static void jit_emit_instruction(JitAssembler *as, CompiledRegex *compiled, int pc, int *table_of_pc) {
+    Instruction *inst = &compiled->code[pc];
+    int fail = jit_special(as, JIT_LABEL_FAIL);
+    int flags = compiled->flags;
+
+    switch (inst->op) {
+        case OP_CHAR:
+            jit_need_byte(as);
+            if ((flags & 2) && isalpha((unsigned char)inst->c)) {
+                jit_test_table(as, table_of_pc[pc], 0, fail);
+            } else {
+                JIT_EMIT(as, 0x80, 0x3C, 0x17, (uint8_t)inst->c);  // cmp byte [rdi + rdx], c
+                jit_jcc(as, JIT_CC_NE, fail);
+            }
+            jit_consumed(as);
+            break;
+
+        case OP_DOT:
+            jit_need_byte(as);
+            if (!(flags & 1)) {
+                JIT_EMIT(as, 0x80, 0x3C, 0x17, '\n');   // cmp byte [rdi + rdx], '\n'
+                jit_jcc(as, JIT_CC_E, fail);
+            }
+            jit_consumed(as);
+            break;
+
+        case OP_CHARSET:
+            jit_need_byte(as);
+            jit_test_table(as, table_of_pc[pc], 0, fail);
+            jit_consumed(as);
+            break;
+
+        case OP_CHOICE: {
+            // Visited bit ((pc * (text_len + 1) + pos) << 1 | los), as in execute()
+            JIT_EMIT(as, 0x49, 0x69, 0xC4);             // imul rax, r12, pc
+            jit_imm32(as, pc);
+            JIT_EMIT(as, 0x48, 0x01, 0xD0,              // add rax, rdx
+                     0x48, 0x01, 0xC0,                  // add rax, rax
+                     0x48, 0x09, 0xD8,                  // or rax, rbx
+                     0x48, 0x0F, 0xAB, 0x01);           // bts [rcx], rax
+            jit_jcc(as, JIT_CC_B, fail);                // Already explored
+
+            jit_check_stack(as);
+            JIT_EMIT(as, 0x48, 0x8D, 0x05);             // lea rax, [rip + alternative]
+            jit_rel32(as, pc + inst->addr);
+            JIT_EMIT(as, 0x49, 0x89, 0x01,              // mov [r9], rax
+                     0x48, 0x8D, 0x04, 0x53,            // lea rax, [rbx + rdx * 2]
+                     0x49, 0x89, 0x41, 0x08,            // mov [r9 + 8], rax
+                     0x49, 0x83, 0xC1, 0x10);           // add r9, 16
+            break;
+        }
+
+        case OP_BRANCH:
+            jit_jmp(as, pc + inst->addr);
+            break;
+
+        case OP_BRANCH_IF_NOT:
+            JIT_EMIT(as, 0x85, 0xDB);                   // test ebx, ebx
+            jit_jcc(as, JIT_CC_NE, pc + inst->addr);
+            break;
+
+        case OP_SAVE_GROUP: {
+            int32_t offset = 4 * (inst->group_num + (inst->is_end ? compiled->group_count : 0));
+            jit_check_stack(as);
+            JIT_EMIT(as, 0x41, 0x8B, 0x80);             // mov eax, [r8 + offset]
+            jit_imm32(as, offset);
+            JIT_EMIT(as, 0x41, 0xBB);                   // mov r11d, slot
+            jit_imm32(as, offset / 4);
+            JIT_EMIT(as, 0x49, 0xC1, 0xE3, 0x20,        // shl r11, 32
+                     0x49, 0x09, 0xC3,                  // or r11, rax
+                     0x49, 0xC7, 0x01, 0, 0, 0, 0,      // mov qword [r9], 0
+                     0x4D, 0x89, 0x59, 0x08,            // mov [r9 + 8], r11
+                     0x49, 0x83, 0xC1, 0x10,            // add r9, 16
+                     0x41, 0x89, 0x90);                 // mov [r8 + offset], edx
+            jit_imm32(as, offset);
+            break;
+        }
+
+        case OP_ANCHOR_START: {
+            int ok = jit_new_label(as);
+            JIT_EMIT(as, 0x48, 0x85, 0xD2);             // test rdx, rdx
+            jit_jcc(as, JIT_CC_E, ok);
+            if (flags & 8) {
+                JIT_EMIT(as, 0x80, 0x7C, 0x17, 0xFF, '\n');  // cmp byte [rdi + rdx - 1], '\n'
+                jit_jcc(as, JIT_CC_E, ok);
+            }
+            jit_jmp(as, fail);
+            jit_place(as, ok);
+            JIT_EMIT(as, 0xBB, 0x01, 0x00, 0x00, 0x00); // mov ebx, 1
+            break;
+        }
+
+        case OP_ANCHOR_END: {
+            int ok = jit_new_label(as);
+            JIT_EMIT(as, 0x48, 0x39, 0xF2);             // cmp rdx, rsi
+            jit_jcc(as, JIT_CC_E, ok);
+            if (flags & 8) {
+                JIT_EMIT(as, 0x80, 0x3C, 0x17, '\n');   // cmp byte [rdi + rdx], '\n'
+                jit_jcc(as, JIT_CC_E, ok);
+            }
+            jit_jmp(as, fail);
+            jit_place(as, ok);
+            JIT_EMIT(as, 0xBB, 0x01, 0x00, 0x00, 0x00); // mov ebx, 1
+            break;
+        }
+
+        case OP_WORD_BOUNDARY:
+        case OP_WORD_BOUNDARY_NEG: {
+            // r11d = (left is word) + (right is word); a boundary when it is 1
+            int word_table = jit_special(as, JIT_LABEL_WORD_TABLE);
+            int no_left = jit_new_label(as);
+            int no_right = jit_new_label(as);
+            JIT_EMIT(as, 0x45, 0x31, 0xDB);             // xor r11d, r11d
+            JIT_EMIT(as, 0x48, 0x85, 0xD2);             // test rdx, rdx
+            jit_jcc(as, JIT_CC_E, no_left);
+            jit_test_table(as, word_table, 1, -1);
+            JIT_EMIT(as, 0x41, 0x83, 0xD3, 0x00);       // adc r11d, 0
+            jit_place(as, no_left);
+            JIT_EMIT(as, 0x48, 0x39, 0xF2);             // cmp rdx, rsi
+            jit_jcc(as, JIT_CC_AE, no_right);
+            jit_test_table(as, word_table, 0, -1);
+            JIT_EMIT(as, 0x41, 0x83, 0xD3, 0x00);       // adc r11d, 0
+            jit_place(as, no_right);
+            JIT_EMIT(as, 0x41, 0x83, 0xFB, 0x01);       // cmp r11d, 1
+            jit_jcc(as, inst->op == OP_WORD_BOUNDARY ? JIT_CC_NE : JIT_CC_E, fail);
+            JIT_EMIT(as, 0xBB, 0x01, 0x00, 0x00, 0x00); // mov ebx, 1
+            break;
+        }
+
+        case OP_MATCH:
+            jit_return(as, 1);
+            break;
+
+        case OP_FAIL:
+            jit_jmp(as, fail);
+            break;
+
+        default:
+            // SAVE_POINTER and ZERO_LENGTH have no effect in execute() either
+            break;
+    }
+}
+
+static void jit_free(RegexJit *jit) {
+    if (!jit) return;
+    munmap(jit->memory, jit->size);
+    free(jit);
+}
+
+static RegexJit* jit_build(CompiledRegex *compiled) {
+    int code_len = compiled->code_len;
+    if (code_len == 0) return NULL;
+    for (int pc = 0; pc < code_len; pc++) {
+        // The data stack is the one piece of VM state the JIT does not model
+        if (compiled->code[pc].op == OP_RESTORE_POSITION) return NULL;
+    }
+
+    JitAssembler as = {
+        .buf = malloc(256),
+        .capacity = 256,
+        .label_count = code_len + JIT_LABEL_COUNT,
+        .fixups = malloc(2 * 64 * sizeof(int)),
+        .fixup_capacity = 64,
+        .code_len = code_len
+    };
+    as.labels = malloc(as.label_count * sizeof(int));
+    for (int i = 0; i < as.label_count; i++) as.labels[i] = -1;
+
+    // Byte tables for CHARSET, DOT and case-folded CHAR
+    int *table_of_pc = malloc(code_len * sizeof(int));
+    for (int pc = 0; pc < code_len; pc++) {
+        Instruction *inst = &compiled->code[pc];
+        int folded_char = inst->op == OP_CHAR && (compiled->flags & 2) && isalpha((unsigned char)inst->c);
+        table_of_pc[pc] = inst->op == OP_CHARSET || folded_char ? jit_new_label(&as) : -1;
+    }
+
+    // Prologue
+    JIT_EMIT(&as, 0x53,                             // push rbx
+             0x41, 0x54,                            // push r12
+             0x4C, 0x8B, 0x54, 0x24, 0x18,          // mov r10, [rsp + 24] (stack_end)
+             0x49, 0x83, 0xEA, 0x10,                // sub r10, 16
+             0x4C, 0x8D, 0x66, 0x01,                // lea r12, [rsi + 1]
+             0x31, 0xDB,                            // xor ebx, ebx
+             0x48, 0x8D, 0x05);                     // lea rax, [rip + no_match]
+    jit_rel32(&as, jit_special(&as, JIT_LABEL_NO_MATCH));
+    JIT_EMIT(&as, 0x49, 0x89, 0x01,                 // mov [r9], rax (bottom entry)
+             0x49, 0xC7, 0x41, 0x08, 0, 0, 0, 0,    // mov qword [r9 + 8], 0
+             0x49, 0x83, 0xC1, 0x10);               // add r9, 16
+
+    for (int pc = 0; pc < code_len; pc++) {
+        jit_place(&as, pc);
+        jit_emit_instruction(&as, compiled, pc, table_of_pc);
+    }
+    jit_return(&as, 0);  // Ran off the end of the program
+
+    // Pop entries until a choice point, undoing captures on the way
+    jit_place(&as, jit_special(&as, JIT_LABEL_FAIL));
+    JIT_EMIT(&as, 0x49, 0x83, 0xE9, 0x10,           // sub r9, 16
+             0x49, 0x8B, 0x01,                      // mov rax, [r9]
+             0x48, 0x85, 0xC0);                     // test rax, rax
+    jit_jcc(&as, JIT_CC_E, jit_special(&as, JIT_LABEL_UNDO));
+    JIT_EMIT(&as, 0x49, 0x8B, 0x51, 0x08,           // mov rdx, [r9 + 8]
+             0x89, 0xD3,                            // mov ebx, edx
+             0x83, 0xE3, 0x01,                      // and ebx, 1
+             0x48, 0xD1, 0xEA,                      // shr rdx, 1
+             0xFF, 0xE0);                           // jmp rax
+
+    jit_place(&as, jit_special(&as, JIT_LABEL_UNDO));
+    JIT_EMIT(&as, 0x49, 0x8B, 0x41, 0x08,           // mov rax, [r9 + 8]
+             0x49, 0x89, 0xC3,                      // mov r11, rax
+             0x49, 0xC1, 0xEB, 0x20,                // shr r11, 32
+             0x43, 0x89, 0x04, 0x98);               // mov [r8 + r11 * 4], eax
+    jit_jmp(&as, jit_special(&as, JIT_LABEL_FAIL));
+
+    jit_place(&as, jit_special(&as, JIT_LABEL_OVERFLOW));
+    jit_return(&as, -1);
+
+    jit_place(&as, jit_special(&as, JIT_LABEL_NO_MATCH));
+    jit_return(&as, 0);
+
+    // Tables, 4-byte aligned for bt
+    while (as.len % 4) JIT_EMIT(&as, 0xCC);
+    uint8_t table[32];
+    memset(table, 0, 32);
+    for (int c = 0; c < 256; c++) {
+        if (is_word_char((char)c)) table[c >> 3] |= 1 << (c & 7);
+    }
+    jit_place(&as, jit_special(&as, JIT_LABEL_WORD_TABLE));
+    jit_bytes(&as, table, 32);
+    for (int pc = 0; pc < code_len; pc++) {
+        if (table_of_pc[pc] < 0) continue;
+        inst_byte_set(compiled, &compiled->code[pc], table);
+        jit_place(&as, table_of_pc[pc]);
+        jit_bytes(&as, table, 32);
+    }
+
+    // Every rel32 is relative to the end of its own field
+    for (int i = 0; i < as.fixup_count; i++) {
+        int at = as.fixups[2 * i];
+        int32_t rel = as.labels[as.fixups[2 * i + 1]] - (at + 4);
+        memcpy(as.buf + at, &rel, 4);
+    }
+
+    RegexJit *jit = NULL;
+    void *memory = mmap(NULL, as.len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory != MAP_FAILED) {
+        memcpy(memory, as.buf, as.len);
+        if (mprotect(memory, as.len, PROT_READ | PROT_EXEC) == 0) {
+            jit = malloc(sizeof(RegexJit));
+            jit->memory = memory;
+            jit->size = as.len;
+            jit->run = (RegexJitFunction)memory;
+        } else {
+            munmap(memory, as.len);
+        }
+    }
+
+    free(table_of_pc);
+    free(as.buf);
+    free(as.labels);
+    free(as.fixups);
+    return jit;
+}
+
+// Backtracking search from start_pos on the generated code.  Returns 1/0, or
+// -1 when the stack limit was hit; visited is then cleared for execute().
+// The captures and the stack live in the scratch.
+static int jit_execute(CompiledRegex *compiled, const char *text, int text_len, int start_pos,
+                       uint8_t *visited, int *group_starts, int *group_ends, RegexScratch *scratch) {
+    RegexJit *jit = compiled->jit;
+    int group_count = compiled->group_count;
+    int *caps = scratch_reserve(&scratch->groups, 2 * group_count * sizeof(int));
+    int capacity = (int)(scratch->stack.size / (2 * sizeof(uint64_t)));
+    if (capacity < 256) capacity = 256;
+    if (capacity > jit_max_stack_entries) capacity = jit_max_stack_entries;
+    uint64_t *stack = scratch_reserve(&scratch->stack, capacity * 2 * sizeof(uint64_t));
+
+    int matched = 0;
+    for (int pos = start_pos; pos <= text_len - compiled->min_length; pos++) {
+        if (compiled->prefix && (pos = prefix_find(compiled->prefix, text, text_len, pos)) < 0) break;
+        for (int i = 0; i < 2 * group_count; i++) caps[i] = -1;
+        matched = jit->run(text, text_len, pos, visited, caps, stack, stack + capacity * 2);
+
+        if (matched < 0) {
+            // Earlier start positions failed for good, so retry this one
+            // from a clean bitset with a bigger stack
+            memset(visited, 0, backtrack_visited_bytes(compiled, text_len));
+            if (capacity >= jit_max_stack_entries) break;
+            capacity *= 2;
+            stack = scratch_reserve(&scratch->stack, capacity * 2 * sizeof(uint64_t));
+            pos--;
+            continue;
+        }
+        if (matched) break;
+    }
+
+    if (matched > 0) {
+        if (group_starts) memcpy(group_starts, caps, group_count * sizeof(int));
+        if (group_ends) memcpy(group_ends, caps + group_count, group_count * sizeof(int));
+    }
+    return matched;
+}
+
+int regex_jit_compile(CompiledRegex *compiled) {
+    if (!compiled) return 0;
+    if (!compiled->jit) {
+        compiled->jit = jit_build(compiled);
+        plan_route(compiled);
+    }
+    return compiled->jit != NULL;
+}
+
+#else
+
+struct RegexJit {
+    int unused;
+};
+
+static void jit_free(struct RegexJit *jit) {
+    (void)jit;
+}
+
+static int jit_execute(CompiledRegex *compiled, const char *text, int text_len, int start_pos,
+                       uint8_t *visited, int *group_starts, int *group_ends, RegexScratch *scratch) {
+    (void)compiled; (void)text; (void)text_len; (void)start_pos;
+    (void)visited; (void)group_starts; (void)group_ends; (void)scratch;
+    return -1;
+}
+
+int regex_jit_compile(CompiledRegex *compiled) {
+    (void)compiled;
+    return 0;
+}
+
+#endif
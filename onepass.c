@@ -0,0 +1,337 @@
+// ================================================================
+// ONE-PASS - Capture engine for patterns that never need to backtrack
+// ================================================================
+// This file is amalgamated into regex.c - do not compile separately
+//
+// A program is one-pass when, after every consumed byte, the next byte alone
+// decides which instruction consumes next.  Each node (pc 0, or the pc after
+// a consuming instruction) gets its epsilon closure flattened at compile time
+// into entries: the consuming pc or MATCH reached, plus the assertions to
+// check and capture slots to write on the way.  Matching is then one table
+// lookup per byte writing straight into a single capture row: no choice
+// stack, no capture trail and no data stack.  A MATCH ranked below the byte
+// taken is remembered as a fallback, which is exactly the answer the
+// backtracker would return if the preferred path died later.
+
+typedef struct {
+    int pc;            // Consuming instruction, or MATCH
+    int target;        // Node entered after consuming, -1 for MATCH
+    int assert_start;  // Assertion pcs on the path, in OnePass.asserts
+    int assert_count;
+    int save_start;    // Capture slots written on the path, in OnePass.saves
+    int save_count;
+} OnePassEntry;
+
+typedef struct {
+    int next[256];     // Entry consuming each byte, or -1
+    int match;         // MATCH entry, or -1; entries of a node are in priority order
+} OnePassNode;
+
+typedef struct OnePass {
+    OnePassNode *nodes;
+    int node_count;
+    OnePassEntry *entries;
+    int entry_count;
+    int *asserts;
+    int *saves;
+} OnePass;
+
+typedef struct {
+    CompiledRegex *compiled;
+    OnePass *op;
+    int *node_of;            // Node index per pc, or -1
+    int *node_pcs;           // pc of each node, in creation order
+    int node_capacity;
+    int *mark;               // Node whose closure last visited each pc
+    uint8_t (*accepts)[32];  // Bytes accepted by each consuming pc, filled on first use
+    uint8_t *accepts_known;
+    int *path_asserts;       // Assertions on the current closure path
+    int path_assert_count;
+    int *path_saves;         // Capture slots on the current closure path
+    int path_save_count;
+    int entry_capacity;
+    int assert_count;
+    int assert_capacity;
+    int save_count;
+    int save_capacity;
+    int current;
+    int failed;
+} OnePassBuilder;
+
+// Larger programs rarely stay one-pass and their tables get big
+static const int onepass_max_nodes = 256;
+
+static void onepass_free(OnePass *op) {
+    if (!op) return;
+    free(op->nodes);
+    free(op->entries);
+    free(op->asserts);
+    free(op->saves);
+    free(op);
+}
+
+static int onepass_node_for(OnePassBuilder *b, int pc) {
+    if (b->node_of[pc] >= 0) return b->node_of[pc];
+    if (b->op->node_count >= onepass_max_nodes) {
+        b->failed = 1;
+        return -1;
+    }
+    if (b->op->node_count >= b->node_capacity) {
+        b->node_capacity *= 2;
+        b->op->nodes = realloc(b->op->nodes, b->node_capacity * sizeof(OnePassNode));
+        b->node_pcs = realloc(b->node_pcs, b->node_capacity * sizeof(int));
+    }
+    int node = b->op->node_count++;
+    b->node_of[pc] = node;
+    b->node_pcs[node] = pc;
+    return node;
+}
+
+static void onepass_add_entry(OnePassBuilder *b, int pc, int target) {
+    OnePass *op = b->op;
+    if (op->entry_count >= b->entry_capacity) {
+        b->entry_capacity *= 2;
+        op->entries = realloc(op->entries, b->entry_capacity * sizeof(OnePassEntry));
+    }
+    while (b->assert_count + b->path_assert_count > b->assert_capacity) {
+        b->assert_capacity *= 2;
+        op->asserts = realloc(op->asserts, b->assert_capacity * sizeof(int));
+    }
+    while (b->save_count + b->path_save_count > b->save_capacity) {
+        b->save_capacity *= 2;
+        op->saves = realloc(op->saves, b->save_capacity * sizeof(int));
+    }
+
+    OnePassEntry *entry = &op->entries[op->entry_count++];
+    entry->pc = pc;
+    entry->target = target;
+    entry->assert_start = b->assert_count;
+    entry->assert_count = b->path_assert_count;
+    entry->save_start = b->save_count;
+    entry->save_count = b->path_save_count;
+
+    memcpy(&op->asserts[b->assert_count], b->path_asserts, b->path_assert_count * sizeof(int));
+    b->assert_count += b->path_assert_count;
+    memcpy(&op->saves[b->save_count], b->path_saves, b->path_save_count * sizeof(int));
+    b->save_count += b->path_save_count;
+}
+
+// Depth-first walk of the epsilon closure in priority order
+static void onepass_closure(OnePassBuilder *b, int pc) {
+    CompiledRegex *compiled = b->compiled;
+    if (b->failed || pc >= compiled->code_len) return;
+
+    // Two paths meeting again (empty alternatives, nullable loop bodies)
+    // make the captures depend on priority order; leave those to the VMs
+    if (b->mark[pc] == b->current) {
+        b->failed = 1;
+        return;
+    }
+    b->mark[pc] = b->current;
+
+    Instruction *inst = &compiled->code[pc];
+    switch (inst->op) {
+        case OP_CHAR:
+        case OP_DOT:
+        case OP_CHARSET: {
+            int target = onepass_node_for(b, pc + 1);
+            if (target >= 0) onepass_add_entry(b, pc, target);
+            break;
+        }
+
+        case OP_MATCH:
+            onepass_add_entry(b, pc, -1);
+            break;
+
+        case OP_CHOICE:
+            onepass_closure(b, pc + 1);
+            onepass_closure(b, pc + inst->addr);
+            break;
+
+        case OP_BRANCH:
+        case OP_BRANCH_IF_NOT:
+            // A loop body that consumed nothing would have revisited its
+            // CHOICE above, so last_operation_success is always set here
+            onepass_closure(b, pc + inst->addr);
+            break;
+
+        case OP_SAVE_GROUP:
+            b->path_saves[b->path_save_count++] = inst->group_num + (inst->is_end ? compiled->group_count : 0);
+            onepass_closure(b, pc + 1);
+            b->path_save_count--;
+            break;
+
+        case OP_ANCHOR_START:
+        case OP_ANCHOR_END:
+        case OP_WORD_BOUNDARY:
+        case OP_WORD_BOUNDARY_NEG:
+            b->path_asserts[b->path_assert_count++] = pc;
+            onepass_closure(b, pc + 1);
+            b->path_assert_count--;
+            break;
+
+        case OP_FAIL:
+            break;
+
+        case OP_RESTORE_POSITION:
+            b->failed = 1;
+            break;
+
+        default:
+            // SAVE_POINTER, ZERO_LENGTH
+            onepass_closure(b, pc + 1);
+            break;
+    }
+}
+
+// Compile-time one-pass check and table construction; NULL if not one-pass
+static OnePass* onepass_build(CompiledRegex *compiled) {
+    int code_len = compiled->code_len;
+    if (code_len == 0) return NULL;
+
+    OnePass *op = calloc(1, sizeof(OnePass));
+    OnePassBuilder b = {
+        .compiled = compiled,
+        .op = op,
+        .node_of = malloc(code_len * sizeof(int)),
+        .node_pcs = malloc(8 * sizeof(int)),
+        .node_capacity = 8,
+        .mark = malloc(code_len * sizeof(int)),
+        .accepts = malloc(code_len * sizeof(*b.accepts)),
+        .accepts_known = calloc(code_len, 1),
+        .path_asserts = malloc(code_len * sizeof(int)),
+        .path_saves = malloc(code_len * sizeof(int)),
+        .entry_capacity = 16,
+        .assert_capacity = 16,
+        .save_capacity = 16
+    };
+    op->nodes = malloc(b.node_capacity * sizeof(OnePassNode));
+    op->entries = malloc(b.entry_capacity * sizeof(OnePassEntry));
+    op->asserts = malloc(b.assert_capacity * sizeof(int));
+    op->saves = malloc(b.save_capacity * sizeof(int));
+    for (int pc = 0; pc < code_len; pc++) {
+        b.node_of[pc] = -1;
+        b.mark[pc] = -1;
+    }
+
+    onepass_node_for(&b, 0);
+    for (int node = 0; node < op->node_count && !b.failed; node++) {
+        int first_entry = op->entry_count;
+        b.current = node;
+        onepass_closure(&b, b.node_pcs[node]);
+
+        OnePassNode *n = &op->nodes[node];
+        n->match = -1;
+        for (int c = 0; c < 256; c++) n->next[c] = -1;
+
+        // Every byte must select at most one consuming entry
+        for (int e = first_entry; e < op->entry_count && !b.failed; e++) {
+            int pc = op->entries[e].pc;
+            Instruction *inst = &compiled->code[pc];
+            if (inst->op == OP_MATCH) {
+                n->match = e;
+                continue;
+            }
+            if (!b.accepts_known[pc]) {
+                inst_byte_set(compiled, inst, b.accepts[pc]);
+                b.accepts_known[pc] = 1;
+            }
+            for (int c = 0; c < 256; c++) {
+                if (!(b.accepts[pc][c >> 3] & (1 << (c & 7)))) continue;
+                if (n->next[c] >= 0) {
+                    b.failed = 1;
+                    break;
+                }
+                n->next[c] = e;
+            }
+        }
+    }
+
+    free(b.node_of);
+    free(b.node_pcs);
+    free(b.mark);
+    free(b.accepts);
+    free(b.accepts_known);
+    free(b.path_asserts);
+    free(b.path_saves);
+
+    if (b.failed) {
+        onepass_free(op);
+        return NULL;
+    }
+    return op;
+}
+
+static int onepass_path_holds(OnePass *op, CompiledRegex *compiled, int entry, const char *text, int text_len, int pos) {
+    OnePassEntry *e = &op->entries[entry];
+    for (int i = 0; i < e->assert_count; i++) {
+        Instruction *inst = &compiled->code[op->asserts[e->assert_start + i]];
+        if (!assertion_holds(inst, text, text_len, pos, compiled->flags)) return 0;
+    }
+    return 1;
+}
+
+// Match anchored at start.  caps is the working capture row and best receives
+// the result.  (node, pos) pairs in visited were reached by an earlier start
+// that found nothing, so reaching one again ends the attempt.
+static int onepass_attempt(OnePass *op, CompiledRegex *compiled, const char *text, int text_len, int start,
+                           uint8_t *visited, int *caps, int *best) {
+    int slot_count = compiled->group_count * 2;
+    for (int i = 0; i < slot_count; i++) caps[i] = -1;
+
+    int matched = 0;
+    int node = 0;
+    int pos = start;
+
+    for (;;) {
+        if (visited) {
+            int bit = node * (text_len + 1) + pos;
+            if (visited[bit >> 3] & (1 << (bit & 7))) break;
+            visited[bit >> 3] |= 1 << (bit & 7);
+        }
+
+        OnePassNode *n = &op->nodes[node];
+        int e = pos < text_len ? n->next[(unsigned char)text[pos]] : -1;
+        int m = n->match;
+        if (e >= 0 && !onepass_path_holds(op, compiled, e, text, text_len, pos)) e = -1;
+        if (m >= 0 && !onepass_path_holds(op, compiled, m, text, text_len, pos)) m = -1;
+
+        if (m >= 0) {
+            OnePassEntry *entry = &op->entries[m];
+            memcpy(best, caps, slot_count * sizeof(int));
+            for (int i = 0; i < entry->save_count; i++) best[op->saves[entry->save_start + i]] = pos;
+            matched = 1;
+            if (e < 0 || m < e) break;  // Preferred over consuming more
+        }
+        if (e < 0) break;
+
+        OnePassEntry *entry = &op->entries[e];
+        for (int i = 0; i < entry->save_count; i++) caps[op->saves[entry->save_start + i]] = pos;
+        pos++;
+        node = entry->target;
+    }
+
+    return matched;
+}
+
+// Leftmost-first search from start_pos, filling group_starts/group_ends
+// (group_count entries each) on success.  visited may be NULL.
+static int onepass_execute(CompiledRegex *compiled, const char *text, int text_len, int start_pos,
+                           uint8_t *visited, int *group_starts, int *group_ends, RegexScratch *scratch) {
+    OnePass *op = compiled->onepass;
+    int group_count = compiled->group_count;
+    int *caps = scratch_reserve(&scratch->groups, 4 * group_count * sizeof(int));
+    int *best = caps + 2 * group_count;
+
+    int matched = 0;
+    for (int pos = start_pos; pos <= text_len - compiled->min_length && !matched; pos++) {
+        if (compiled->prefix && (pos = prefix_find(compiled->prefix, text, text_len, pos)) < 0) break;
+        matched = onepass_attempt(op, compiled, text, text_len, pos, visited, caps, best);
+    }
+
+    if (matched) {
+        memcpy(group_starts, best, group_count * sizeof(int));
+        memcpy(group_ends, best + group_count, group_count * sizeof(int));
+    }
+    return matched;
+}
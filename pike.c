@@ -0,0 +1,330 @@
+// ================================================================
+// PIKE VM - Thompson NFA simulation over the compiled bytecode
+// ================================================================
+// This file is amalgamated into regex.c - do not compile separately
+//
+// Runs the same Instruction program as the backtracker in execute.c, but
+// advances every live thread in lock-step over the input.  A thread is a pc
+// plus the backtracker's last_operation_success flag, which BRANCH_IF_NOT
+// reads and which is part of the state the backtracker remembers at each
+// CHOICE.  Each (pc, flag) is added to a thread list at most once per
+// position (sparse set), so the total work is O(code_len * text_len) no
+// matter how ambiguous the pattern is.  Threads are kept in priority order,
+// and a state found again at the same position dies just as the
+// backtracker's visited check fails it, so empty loop iterations end the
+// same way and the leftmost-first captures agree.
+
+// Shared helpers for the automaton engines
+
+static int is_word_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || (c == '_');
+}
+
+// Check whether a consuming instruction (CHAR, DOT, CHARSET) of compiled
+// accepts c
+static int inst_matches_char(CompiledRegex *compiled, Instruction *inst, char c) {
+    int flags = compiled->flags;
+    switch (inst->op) {
+        case OP_CHAR:
+            if (flags & 2) { // Case insensitive flag 'i': inst->c is lower case
+                return ascii_fold((unsigned char)c) == (unsigned char)inst->c;
+            }
+            return c == inst->c;
+
+        case OP_DOT:
+            return c != '\n' || (flags & 1); // 's' flag lets . match newline
+
+        case OP_CHARSET: {
+            // Compiled with both cases of each letter under i
+            int matches = charset_contains(compiled->charsets[inst->charset], c);
+            return inst->negate ? !matches : matches;
+        }
+
+        default:
+            return 0;
+    }
+}
+
+// Fill set (32 bytes) with every byte a CHAR c, DOT or CHARSET charset
+// accepts under flags.  Folds again under i, so it works both on compiled
+// instructions and on AST nodes, which are not folded yet.
+static void op_byte_set(int op, char ch, const uint8_t *charset, int negate, int flags, uint8_t *set) {
+    memset(set, 0, 32);
+    switch (op) {
+        case OP_CHAR: {
+            unsigned char c = (unsigned char)ch;
+            set[c >> 3] |= 1 << (c & 7);
+            if ((flags & 2) && ascii_fold(c) >= 'a' && ascii_fold(c) <= 'z') {
+                unsigned char other = c ^ 0x20;  // The other case
+                set[other >> 3] |= 1 << (other & 7);
+            }
+            break;
+        }
+
+        case OP_DOT:
+            memset(set, 0xff, 32);
+            if (!(flags & 1)) set['\n' >> 3] &= ~(1 << ('\n' & 7));
+            break;
+
+        case OP_CHARSET:
+            memcpy(set, charset, 32);
+            if (flags & 2) charset_fold_case(set);
+            if (negate) {
+                for (int i = 0; i < 32; i++) set[i] = ~set[i];
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+// Every byte inst_matches_char accepts for inst
+static void inst_byte_set(CompiledRegex *compiled, Instruction *inst, uint8_t *set) {
+    const uint8_t *charset = inst->op == OP_CHARSET ? compiled->charsets[inst->charset] : NULL;
+    op_byte_set(inst->op, inst->c, charset, inst->negate, compiled->flags, set);
+}
+
+// Every byte a CHAR, DOT or CHARSET node matches - the same set the VMs
+// use, with the flags applied
+static void ast_byte_set(ASTNode *node, int flags, uint8_t *set) {
+    if (node->type == AST_CHAR) {
+        op_byte_set(OP_CHAR, node->data.character, NULL, 0, flags, set);
+    } else if (node->type == AST_DOT) {
+        op_byte_set(OP_DOT, 0, NULL, 0, flags, set);
+    } else {
+        op_byte_set(OP_CHARSET, 0, node->data.charset.charset, node->data.charset.negate, flags, set);
+    }
+}
+
+// Check a zero-width assertion (anchors, word boundaries) at pos
+static int assertion_holds(Instruction *inst, const char *text, int text_len, int pos, int flags) {
+    switch (inst->op) {
+        case OP_ANCHOR_START:
+            return pos == 0 || ((flags & 8) && text[pos - 1] == '\n');
+
+        case OP_ANCHOR_END:
+            return pos == text_len || ((flags & 8) && text[pos] == '\n');
+
+        case OP_WORD_BOUNDARY:
+        case OP_WORD_BOUNDARY_NEG: {
+            int left_is_word = pos > 0 && is_word_char(text[pos - 1]);
+            int right_is_word = pos < text_len && is_word_char(text[pos]);
+            int is_word_boundary = left_is_word != right_is_word;
+            return inst->op == OP_WORD_BOUNDARY ? is_word_boundary : !is_word_boundary;
+        }
+
+        default:
+            return 1;
+    }
+}
+
+// Thread list: sparse set of states (pc << 1 | flag) plus one capture slot
+// row per dense entry
+typedef struct {
+    int *sparse;
+    int *dense;
+    int *caps;
+    int count;
+} PikeThreadList;
+
+typedef struct {
+    CompiledRegex *compiled;
+    const char *text;
+    int text_len;
+    int slot_count;        // 2 * group_count: starts then ends
+    int *stack;            // Explicit closure stack (pc, or encoded capture restore)
+    int stack_capacity;
+    ScratchBuffer *stack_buffer;  // Where the stack grows
+    int *work_caps;        // Captures of the thread currently being followed
+} PikeVM;
+
+static int pike_list_contains(PikeThreadList *list, int state) {
+    int i = list->sparse[state];
+    return i < list->count && list->dense[i] == state;
+}
+
+// Stack entries: a state pc << 1 | flag >= 0 means "follow this pc with
+// last_operation_success = flag"; a negative entry -(slot + 1) means
+// "restore capture slot", with the old value stored just below it.
+static void pike_push(PikeVM *pike, int *top, int value) {
+    if (*top >= pike->stack_capacity) {
+        pike->stack_capacity *= 2;
+        pike->stack = scratch_grow(pike->stack_buffer, pike->stack_capacity * sizeof(int));
+    }
+    pike->stack[(*top)++] = value;
+}
+
+// Follow epsilon transitions from pc at pos, entered with the backtracker's
+// last_operation_success = flag, appending threads in priority order
+static void pike_add_thread(PikeVM *pike, PikeThreadList *list, int start_pc, int flag, int pos) {
+    CompiledRegex *compiled = pike->compiled;
+    int top = 0;
+    pike_push(pike, &top, start_pc << 1 | flag);
+
+    while (top > 0) {
+        int entry = pike->stack[--top];
+
+        if (entry < 0) {
+            // Undo a capture made on a path we have finished exploring
+            int slot = -entry - 1;
+            pike->work_caps[slot] = pike->stack[--top];
+            continue;
+        }
+
+        int pc = entry >> 1;
+        flag = entry & 1;
+        if (pc >= compiled->code_len) continue;
+
+        // Where the thread goes from a consuming pc or MATCH does not depend
+        // on the flag, so those are kept once whatever it is
+        Instruction *inst = &compiled->code[pc];
+        int consumes = inst->op == OP_CHAR || inst->op == OP_DOT || inst->op == OP_CHARSET || inst->op == OP_MATCH;
+        int state = consumes ? pc << 1 : entry;
+        if (pike_list_contains(list, state)) continue;
+
+        list->sparse[state] = list->count;
+        list->dense[list->count] = state;
+        int index = list->count++;
+
+        switch (inst->op) {
+            case OP_CHAR:
+            case OP_DOT:
+            case OP_CHARSET:
+            case OP_MATCH:
+                memcpy(&list->caps[index * pike->slot_count], pike->work_caps, pike->slot_count * sizeof(int));
+                break;
+
+            case OP_CHOICE:
+                // Pushed in reverse so pc + 1 (the preferred path) is explored
+                // first; the alternative resumes with the flag as it is now
+                pike_push(pike, &top, (pc + inst->addr) << 1 | flag);
+                pike_push(pike, &top, (pc + 1) << 1 | flag);
+                break;
+
+            case OP_BRANCH:
+                // Loop back edge; an empty iteration that comes back with the
+                // same flag finds its state already in the list and dies
+                pike_push(pike, &top, (pc + inst->addr) << 1 | flag);
+                break;
+
+            case OP_BRANCH_IF_NOT:
+                // Loop again only if the last consuming step or assertion held
+                pike_push(pike, &top, (flag ? pc + inst->addr : pc + 1) << 1 | flag);
+                break;
+
+            case OP_SAVE_GROUP: {
+                int slot = inst->group_num + (inst->is_end ? compiled->group_count : 0);
+                pike_push(pike, &top, pike->work_caps[slot]);
+                pike_push(pike, &top, -slot - 1);
+                pike->work_caps[slot] = pos;
+                pike_push(pike, &top, (pc + 1) << 1 | flag);
+                break;
+            }
+
+            case OP_ANCHOR_START:
+            case OP_ANCHOR_END:
+            case OP_WORD_BOUNDARY:
+            case OP_WORD_BOUNDARY_NEG:
+                if (assertion_holds(inst, pike->text, pike->text_len, pos, compiled->flags)) {
+                    pike_push(pike, &top, (pc + 1) << 1 | 1);
+                }
+                break;
+
+            case OP_FAIL:
+                break;
+
+            default:
+                // SAVE_POINTER, RESTORE_POSITION and ZERO_LENGTH carry no
+                // meaning once every thread advances in lock-step
+                pike_push(pike, &top, (pc + 1) << 1 | flag);
+                break;
+        }
+    }
+}
+
+// Run a leftmost-first search starting at start_pos.  On success fills
+// group_starts/group_ends (group_count entries each, may be NULL) and
+// returns 1.  The thread lists and the stack live in the scratch.
+static int pike_execute(CompiledRegex *compiled, const char *text, int text_len, int start_pos,
+                        int *group_starts, int *group_ends, RegexScratch *scratch) {
+    int code_len = compiled->code_len;
+    int slot_count = compiled->group_count * 2;
+    int state_count = 2 * code_len;  // pc << 1 | flag
+    int stack_capacity = (int)(scratch->stack.size / sizeof(int));
+    if (stack_capacity < 3 * state_count + 2) stack_capacity = 3 * state_count + 2;
+
+    PikeVM pike = {
+        .compiled = compiled,
+        .text = text,
+        .text_len = text_len,
+        .slot_count = slot_count,
+        .stack = scratch_reserve(&scratch->stack, stack_capacity * sizeof(int)),
+        .stack_capacity = stack_capacity,
+        .stack_buffer = &scratch->stack
+    };
+
+    // Per list: sparse and dense state sets, then captures per thread
+    int list_ints = 2 * state_count + state_count * slot_count;
+    int *ints = scratch_reserve(&scratch->pike, (2 * slot_count + 2 * list_ints) * sizeof(int));
+    pike.work_caps = ints;
+    int *best_caps = ints + slot_count;
+
+    PikeThreadList lists[2];
+    for (int i = 0; i < 2; i++) {
+        int *list = ints + 2 * slot_count + i * list_ints;
+        lists[i].sparse = list;
+        lists[i].dense = list + state_count;
+        lists[i].caps = list + 2 * state_count;
+        lists[i].count = 0;
+        memset(lists[i].sparse, 0, state_count * sizeof(int));
+    }
+
+    PikeThreadList *clist = &lists[0];
+    PikeThreadList *nlist = &lists[1];
+    int matched = 0;
+
+    for (int pos = start_pos; pos <= text_len; pos++) {
+        // Seed a new thread at the lowest priority until a match is found,
+        // while the shortest match still fits
+        if (!matched && pos <= text_len - compiled->min_length) {
+            // No thread is alive, so skip to the next occurrence of the prefix
+            if (clist->count == 0 && compiled->prefix &&
+                (pos = prefix_find(compiled->prefix, text, text_len, pos)) < 0) break;
+            for (int i = 0; i < slot_count; i++) pike.work_caps[i] = -1;
+            pike_add_thread(&pike, clist, 0, 0, pos);
+        }
+        if (clist->count == 0) break;
+
+        nlist->count = 0;
+        for (int i = 0; i < clist->count; i++) {
+            int pc = clist->dense[i] >> 1;
+            Instruction *inst = &compiled->code[pc];
+            int *caps = &clist->caps[i * slot_count];
+
+            if (inst->op == OP_MATCH) {
+                // Lower-priority threads can never win against this one
+                memcpy(best_caps, caps, slot_count * sizeof(int));
+                matched = 1;
+                break;
+            }
+
+            if ((inst->op == OP_CHAR || inst->op == OP_DOT || inst->op == OP_CHARSET) && pos < text_len &&
+                inst_matches_char(compiled, inst, text[pos])) {
+                memcpy(pike.work_caps, caps, slot_count * sizeof(int));
+                pike_add_thread(&pike, nlist, pc + 1, 1, pos + 1);
+            }
+        }
+
+        PikeThreadList *tmp = clist;
+        clist = nlist;
+        nlist = tmp;
+    }
+
+    if (matched) {
+        if (group_starts) memcpy(group_starts, best_caps, compiled->group_count * sizeof(int));
+        if (group_ends) memcpy(group_ends, best_caps + compiled->group_count, compiled->group_count * sizeof(int));
+    }
+
+    return matched;
+}
@@ -0,0 +1,422 @@
+// ================================================================
+// PLANNER - Per-pattern choice of matching strategy
+// ================================================================
+// This file is amalgamated into regex.c - do not compile separately
+//
+// compile_ast records what the pattern looks like (anchors, literal content,
+// captures, constructs that make backtracking expensive) in compiled->plan;
+// plan_route then picks the cheapest engine that gives correct answers for
+// each kind of call, given the automata that were actually built.  It runs
+// again whenever an engine is added later (compile_regex_dfa,
+// regex_jit_compile).  The analysis also decides how the backtracker
+// remembers explored states.  Per-call fallbacks - a state cache that keeps
+// overflowing, visited blocks that outgrow REGEX_BACKTRACK_VISITED_LIMIT - are
+// recorded in the scratch the call ran with, and print_regex_plan shows it
+// all.
+
+static int ast_nullable(ASTNode *node) {
+    if (!node) return 1;
+
+    switch (node->type) {
+        case AST_CHAR:
+        case AST_DOT:
+        case AST_CHARSET:
+            return 0;
+
+        case AST_GROUP:
+            return ast_nullable(node->data.group.content);
+
+        case AST_SEQUENCE:
+            for (int i = 0; i < node->data.sequence.child_count; i++) {
+                if (!ast_nullable(node->data.sequence.children[i])) return 0;
+            }
+            return 1;
+
+        case AST_ALTERNATION:
+            for (int i = 0; i < node->data.alternation.alternative_count; i++) {
+                if (ast_nullable(node->data.alternation.alternatives[i])) return 1;
+            }
+            return 0;
+
+        case AST_QUANTIFIER:
+            if (node->data.quantifier.quantifier == '+' ||
+                (node->data.quantifier.quantifier == '{' && node->data.quantifier.min_count > 0)) {
+                return ast_nullable(node->data.quantifier.target);
+            }
+            return 1;
+
+        default:
+            // Assertions
+            return 1;
+    }
+}
+
+// Every match of node begins (at_end == 0) or ends (at_end == 1) with
+// the anchor for that side
+static int ast_anchored(ASTNode *node, int at_end) {
+    if (!node) return 0;
+
+    switch (node->type) {
+        case AST_ANCHOR_START:
+            return !at_end;
+
+        case AST_ANCHOR_END:
+            return at_end;
+
+        case AST_GROUP:
+            return ast_anchored(node->data.group.content, at_end);
+
+        case AST_SEQUENCE: {
+            int count = node->data.sequence.child_count;
+            if (count == 0) return 0;
+            return ast_anchored(node->data.sequence.children[at_end ? count - 1 : 0], at_end);
+        }
+
+        case AST_ALTERNATION:
+            for (int i = 0; i < node->data.alternation.alternative_count; i++) {
+                if (!ast_anchored(node->data.alternation.alternatives[i], at_end)) return 0;
+            }
+            return 1;
+
+        case AST_QUANTIFIER:
+            if (node->data.quantifier.quantifier == '+' ||
+                (node->data.quantifier.quantifier == '{' && node->data.quantifier.min_count > 0)) {
+                return ast_anchored(node->data.quantifier.target, at_end);
+            }
+            return 0;
+
+        default:
+            return 0;
+    }
+}
+
+// Matches exactly one byte, like a character class
+static int ast_single_byte(ASTNode *node) {
+    if (node->type == AST_GROUP) return node->data.group.content && ast_single_byte(node->data.group.content);
+    return node->type == AST_CHAR || node->type == AST_DOT || node->type == AST_CHARSET;
+}
+
+// Unbounded loops whose body can match in more than one way (alternation,
+// another quantifier) or match nothing: (a|ab)*, (a+)+, (b?)*.  These are
+// the patterns whose backtracking cost is bounded only by the visited set.
+static int ast_backtrack_sensitive(ASTNode *node, int in_loop) {
+    if (!node) return 0;
+
+    switch (node->type) {
+        case AST_GROUP:
+            return ast_backtrack_sensitive(node->data.group.content, in_loop);
+
+        case AST_SEQUENCE:
+            for (int i = 0; i < node->data.sequence.child_count; i++) {
+                if (ast_backtrack_sensitive(node->data.sequence.children[i], in_loop)) return 1;
+            }
+            return 0;
+
+        case AST_ALTERNATION:
+            for (int i = 0; i < node->data.alternation.alternative_count; i++) {
+                ASTNode *alternative = node->data.alternation.alternatives[i];
+                // (x|y)* is just a character class; anything longer may split
+                // the same text between iterations in several ways
+                if (in_loop && !ast_single_byte(alternative)) return 1;
+                if (ast_backtrack_sensitive(alternative, in_loop)) return 1;
+            }
+            return 0;
+
+        case AST_QUANTIFIER: {
+            char quantifier = node->data.quantifier.quantifier;
+            int unbounded = quantifier == '*' || quantifier == '+' ||
+                            (quantifier == '{' && node->data.quantifier.max_count == -1);
+            if (in_loop && quantifier != '{') return 1;
+            if (unbounded && ast_nullable(node->data.quantifier.target)) return 1;
+            return ast_backtrack_sensitive(node->data.quantifier.target, in_loop || unbounded);
+        }
+
+        default:
+            return 0;
+    }
+}
+
+static int ast_literal_length(ASTNode *node) {
+    if (!node) return 0;
+    if (node->type == AST_CHAR) return 1;
+    if (node->type != AST_SEQUENCE) return 0;
+
+    for (int i = 0; i < node->data.sequence.child_count; i++) {
+        if (node->data.sequence.children[i]->type != AST_CHAR) return 0;
+    }
+    return node->data.sequence.child_count;
+}
+
+// Bytes every match of node ends with, last byte first, appended to
+// suffix up to capacity.  Returns 1 if node is nothing but those bytes, so
+// the caller can go on with what precedes it.
+static int ast_literal_suffix(ASTNode *node, int flags, char *suffix, int *length, int capacity) {
+    if (!node) return 1;
+
+    switch (node->type) {
+        case AST_CHAR: {
+            if (*length == capacity) return 0;
+            unsigned char c = node->data.character;
+            suffix[(*length)++] = (flags & 2) && c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+            return 1;
+        }
+
+        case AST_GROUP:
+            return ast_literal_suffix(node->data.group.content, flags, suffix, length, capacity);
+
+        case AST_SEQUENCE:
+            for (int i = node->data.sequence.child_count - 1; i >= 0; i--) {
+                if (!ast_literal_suffix(node->data.sequence.children[i], flags, suffix, length, capacity)) return 0;
+            }
+            return 1;
+
+        case AST_ALTERNATION: {
+            // The part the alternatives' suffixes have in common
+            int count = node->data.alternation.alternative_count;
+            char first[16];
+            int common = 0;
+            int whole = ast_literal_suffix(node->data.alternation.alternatives[0], flags, first, &common,
+                                           capacity - *length);
+            for (int i = 1; i < count; i++) {
+                char other[16];
+                int other_length = 0;
+                int other_whole = ast_literal_suffix(node->data.alternation.alternatives[i], flags, other,
+                                                     &other_length, capacity - *length);
+                int same = 0;
+                while (same < common && same < other_length && first[same] == other[same]) same++;
+                whole = whole && other_whole && same == common && same == other_length;
+                common = same;
+            }
+            memcpy(suffix + *length, first, common);
+            *length += common;
+            return whole;
+        }
+
+        case AST_QUANTIFIER:
+            if (node->data.quantifier.quantifier == '+' ||
+                (node->data.quantifier.quantifier == '{' && node->data.quantifier.min_count > 0)) {
+                ast_literal_suffix(node->data.quantifier.target, flags, suffix, length, capacity);
+            }
+            return 0;
+
+        case AST_ANCHOR_START:
+        case AST_ANCHOR_END:
+        case AST_WORD_BOUNDARY:
+        case AST_WORD_BOUNDARY_NEG:
+            // Assertions match no text
+            return 1;
+
+        default:
+            return 0;
+    }
+}
+
+// Programs at least this long clear more visited bits per text byte than a
+// search usually touches
+static const int plan_large_program = 256;
+
+static void plan_analyze(CompiledRegex *compiled, ASTNode *ast) {
+    RegexPlan *plan = &compiled->plan;
+    plan->anchored_start = ast_anchored(ast, 0);
+    plan->anchored_end = ast_anchored(ast, 1);
+    plan->literal_length = ast_literal_length(ast);
+    plan->capture_count = compiled->group_count - 1;
+    plan->backtrack_sensitive = ast_backtrack_sensitive(ast, 0);
+    prefix_length_bounds(ast, &compiled->min_length, &compiled->max_length);
+
+    // Stored last byte first while it is collected
+    char suffix[sizeof(plan->suffix)];
+    plan->suffix_length = 0;
+    ast_literal_suffix(ast, compiled->flags, suffix, &plan->suffix_length, sizeof(plan->suffix));
+    for (int i = 0; i < plan->suffix_length; i++) plan->suffix[i] = suffix[plan->suffix_length - 1 - i];
+}
+
+static void plan_route(CompiledRegex *compiled) {
+    RegexPlan *plan = &compiled->plan;
+
+    // Literal patterns are answered by a string search, literal
+    // alternations by their automaton, with nothing else to run
+    if ((compiled->substring || compiled->aho) && compiled->pinned == REGEX_MATCHER_NONE) {
+        plan->test = compiled->substring ? REGEX_MATCHER_SUBSTRING : REGEX_MATCHER_AHO_CORASICK;
+        plan->exec = plan->test;
+        plan->find_span = 0;
+        plan->span_only = 0;
+        plan->visited_blocks = 0;
+        return;
+    }
+
+    // Outside multiline mode every match of a pattern ending at $ ends at
+    // the end of the text, so the reverse program finds it reading back
+    // from there, no further than the match reaches
+    plan->from_end = plan->anchored_end && !(compiled->flags & 8);
+
+    // Yes/no: a finished table beats a scan from the end, which beats the
+    // bit-parallel NFA, which beats building DFA states on the fly
+    if (compiled->full_dfa) {
+        plan->test = REGEX_MATCHER_FULL_DFA;
+    } else if (plan->from_end) {
+        plan->test = REGEX_MATCHER_REVERSE_DFA;
+    } else if (compiled->bitnfa) {
+        plan->test = REGEX_MATCHER_BITNFA;
+    } else {
+        plan->test = REGEX_MATCHER_LAZY_DFA;
+    }
+
+    // Captures: the DFAs locate the match first; with no groups beyond the
+    // whole match that span is the complete answer
+    plan->find_span = 1;
+    plan->span_only = plan->find_span && plan->capture_count == 0;
+
+    if (compiled->jit) {
+        plan->exec = REGEX_MATCHER_JIT;
+    } else if (compiled->onepass) {
+        plan->exec = REGEX_MATCHER_ONEPASS;
+    } else if (compiled->engine == REGEX_ENGINE_PIKE) {
+        plan->exec = REGEX_MATCHER_PIKE;
+    } else {
+        plan->exec = REGEX_MATCHER_BACKTRACK;
+    }
+
+    // A matcher pinned by the caller runs alone, from every start position
+    if (compiled->pinned != REGEX_MATCHER_NONE) {
+        plan->exec = compiled->pinned;
+        plan->find_span = 0;
+        plan->span_only = 0;
+    }
+
+    // A flat bitset is cleared for the whole text on every call.  Linear
+    // patterns reach few of its states and large programs make it wide, so
+    // those allocate blocks as the search reaches them; loops that may split
+    // the text many ways touch most states and are faster on one bitset.
+    plan->visited_blocks = plan->exec == REGEX_MATCHER_BACKTRACK &&
+                           (!plan->backtrack_sensitive || compiled->code_len >= plan_large_program);
+}
+
+// The capture engine a search runs: the plan's, unless the Pike VM was
+// chosen on the CompiledRegex after compilation and nothing is pinned
+static RegexMatcher plan_exec(const CompiledRegex *compiled) {
+    if (compiled->plan.exec == REGEX_MATCHER_BACKTRACK && compiled->engine == REGEX_ENGINE_PIKE &&
+        compiled->pinned == REGEX_MATCHER_NONE) {
+        return REGEX_MATCHER_PIKE;
+    }
+    return compiled->plan.exec;
+}
+
+// Run every capture search on matcher alone: the backtracking VM or the
+// Pike VM, or the one-pass engine or JIT where they were built.
+// REGEX_MATCHER_NONE goes back to the plan.  Returns 0 for matchers that
+// cannot record this pattern's captures.
+int regex_pin_matcher(CompiledRegex *compiled, RegexMatcher matcher) {
+    if (!compiled) return 0;
+    if (matcher != REGEX_MATCHER_NONE && matcher != REGEX_MATCHER_BACKTRACK && matcher != REGEX_MATCHER_PIKE &&
+        !(matcher == REGEX_MATCHER_ONEPASS && compiled->onepass) && !(matcher == REGEX_MATCHER_JIT && compiled->jit)) {
+        return 0;
+    }
+    compiled->pinned = matcher;
+    plan_route(compiled);
+    return 1;
+}
+
+static const char* regex_matcher_name(RegexMatcher matcher) {
+    switch (matcher) {
+        case REGEX_MATCHER_BACKTRACK: return "backtracking VM";
+        case REGEX_MATCHER_PIKE: return "Pike VM";
+        case REGEX_MATCHER_ONEPASS: return "one-pass engine";
+        case REGEX_MATCHER_JIT: return "JIT";
+        case REGEX_MATCHER_LAZY_DFA: return "lazy DFA";
+        case REGEX_MATCHER_BITNFA: return "bit-parallel NFA";
+        case REGEX_MATCHER_FULL_DFA: return "full DFA";
+        case REGEX_MATCHER_SPAN_DFA: return "span DFAs";
+        case REGEX_MATCHER_REVERSE_DFA: return "reverse DFA from the end";
+        case REGEX_MATCHER_AHO_CORASICK: return "Aho-Corasick automaton";
+        case REGEX_MATCHER_SUBSTRING: return "substring search";
+        default: return "none";
+    }
+}
+
+static void print_plan_literal(const char *literal, int length) {
+    putchar('"');
+    for (int i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)literal[i];
+        if (c >= 32 && c < 127 && c != '"' && c != '\\') putchar(c);
+        else printf("\\x%02x", c);
+    }
+    putchar('"');
+}
+
+void print_regex_plan(const CompiledRegex *compiled) {
+    const RegexPlan *plan = &compiled->plan;
+    RegexMatcher exec = plan_exec(compiled);
+
+    printf("Plan:\n");
+    printf("  program:      %d instructions, %d captures, %d visited bits per text byte\n",
+           compiled->code_len, plan->capture_count, compiled->code_len * 2);
+    const char *anchors = plan->anchored_start ? (plan->anchored_end ? "start and end" : "start") :
+                          (plan->anchored_end ? "end" : "none");
+    printf("  anchors:      %s%s\n", anchors,
+           (plan->anchored_start || plan->anchored_end) && (compiled->flags & 8) ? " of line" : "");
+    if (compiled->max_length < 0) {
+        printf("  length:       %d bytes or more\n", compiled->min_length);
+    } else if (compiled->max_length > compiled->min_length) {
+        printf("  length:       %d-%d bytes\n", compiled->min_length, compiled->max_length);
+    } else {
+        printf("  length:       %d bytes\n", compiled->min_length);
+    }
+    if (plan->literal_length > 0) {
+        printf("  literal:      %d bytes\n", plan->literal_length);
+    }
+    if (compiled->prefix) {
+        LiteralPrefix *prefix = compiled->prefix;
+        const char *scan = prefix->count > 1 ? "Teddy" : prefix->single ? "substring search" :
+                           prefix->first_byte >= 0 ? "memchr" : "byte scan";
+        if (prefix->count > 0) {
+            printf("  prefix:      ");
+            for (int i = 0; i < prefix->count; i++) {
+                printf(" ");
+                print_plan_literal(prefix->literals[i], prefix->lengths[i]);
+            }
+            printf("%s (%s)\n", prefix->fold ? " in either case" : "", scan);
+        } else if (prefix->first_byte_count > 0) {
+            printf("  prefix:       one of %d bytes (%s)\n", prefix->first_byte_count, scan);
+        }
+        if (prefix->inner_length > 0) {
+            printf("  required:     ");
+            print_plan_literal(prefix->inner, prefix->inner_length);
+            if (prefix->inner_max_offset < 0) {
+                printf(" at offset %d or later\n", prefix->inner_min_offset);
+            } else {
+                printf(" at offset %d-%d\n", prefix->inner_min_offset, prefix->inner_max_offset);
+            }
+        }
+    }
+    if (plan->from_end && plan->suffix_length > 0) {
+        printf("  suffix:       ");
+        print_plan_literal(plan->suffix, plan->suffix_length);
+        printf(" (compared at the end)\n");
+    }
+    if (compiled->aho) {
+        AhoCorasick *aho = compiled->aho;
+        printf("  literals:     %d, %d states x %d byte classes, leftmost-%s\n",
+               aho->literal_count, aho->state_count, aho->class_count, aho->longest ? "longest" : "first");
+    }
+    printf("  backtracking: %s%s\n", plan->backtrack_sensitive ?
+           "sensitive (loops over alternatives, nested or empty loops)" : "linear",
+           plan->span_only || exec != REGEX_MATCHER_BACKTRACK ? "" :
+           plan->visited_blocks ? ", visited set in blocks" : ", one visited bitset");
+    printf("  test:         %s\n", regex_matcher_name(plan->test));
+    const char *span = plan->from_end ? "reverse DFA from the end" : "span DFAs";
+    if (plan->span_only) {
+        printf("  exec:         %s only\n", span);
+    } else if (plan->find_span) {
+        printf("  exec:         %s, then %s\n", span, regex_matcher_name(exec));
+    } else {
+        printf("  exec:         %s%s\n", regex_matcher_name(exec),
+               compiled->pinned != REGEX_MATCHER_NONE ? " (pinned)" : "");
+    }
+    RegexMatcher last_test = regex_scratch_last_test(compiled->scratch);
+    RegexMatcher last_exec = regex_scratch_last_exec(compiled->scratch);
+    if (last_test != REGEX_MATCHER_NONE || last_exec != REGEX_MATCHER_NONE) {
+        printf("  last calls:   test ran %s, exec ran %s\n",
+               regex_matcher_name(last_test), regex_matcher_name(last_exec));
+    }
+}
@@ -0,0 +1,648 @@
+// ================================================================
+// LITERAL PREFIX - Skip start positions that cannot begin a match
+// ================================================================
+// This file is amalgamated into regex.c - do not compile separately
+//
+// Built from the AST: the set of literal strings one of which every match
+// must start with (ERROR: gives one literal, https?:// gives "http",
+// (GET|POST) / gives two), or failing that the set of bytes a match can
+// start with (\d+ms, [A-Z]\w+, a*b).  Start-position loops and automata
+// that are back in their start state call prefix_find to jump straight to
+// the next candidate offset instead of trying each one.  A single first
+// byte is located with memchr, several with byte_scan, and literals are
+// then confirmed with memcmp; two or more literals are found together
+// with Teddy.
+//
+// The longest literal every match must contain somewhere (@example.com in
+// \w+@example\.com) is recorded too, with the range of distances from the
+// match start at which it can begin.  When it does not occur at all the
+// search is over before any engine runs; when that distance is bounded,
+// prefix_find only returns positions close enough before an occurrence.
+//
+// A pattern anchored at ^ gets a LiteralPrefix even without literals: it
+// can only start at offset 0, so a search from anywhere else ends at once,
+// or under m at a line start, found with memchr('\n').
+//
+// Under i the literals are kept in lower case rather than as every mix of
+// cases (32 for "error"), and found case-folded: a single literal with the
+// substring searcher, which lets both cases of each letter through its
+// SIMD filter at once, several with Teddy tables that hold both cases.
+
+#define PREFIX_ANCHOR_NONE 0
+#define PREFIX_ANCHOR_TEXT 1  // Matches start at offset 0 only
+#define PREFIX_ANCHOR_LINE 2  // Matches start at offset 0 or after a '\n'
+
+#define PREFIX_MAX_LITERALS 32
+#define PREFIX_MAX_LENGTH 16
+#define PREFIX_MAX_INNER 32
+
+typedef struct LiteralPrefix {
+    int count;                // 0: only the first byte is known
+    int lengths[PREFIX_MAX_LITERALS];
+    char literals[PREFIX_MAX_LITERALS][PREFIX_MAX_LENGTH];
+    int min_length;                // Bytes any match spans from its start: later starts are not tried
+    Teddy teddy;              // Finds any of two or more literals
+    ByteScanner first_bytes;  // Every byte a match can start with
+    int first_byte_count;     // 0: any byte may start a match
+    int first_byte;           // The only such byte, or -1
+    char inner[PREFIX_MAX_INNER];  // Literal every match contains
+    int inner_length;              // 0: none known
+    int inner_rare;                // Index of its least common byte, searched with memchr
+    int inner_min_offset;          // Distance from the match start to it
+    int inner_max_offset;          // -1: unbounded
+    int anchor;                    // PREFIX_ANCHOR_*
+    int fold;                      // i flag: literals are lower case and match either case
+    struct Substring *single;      // Searcher for the only literal, when it is 2 bytes or longer
+} LiteralPrefix;
+
+typedef struct {
+    int count;         // 0: no literal is known for this node
+    int lengths[PREFIX_MAX_LITERALS];
+    char literals[PREFIX_MAX_LITERALS][PREFIX_MAX_LENGTH];
+    int complete;      // Each literal covers the whole node, so what follows can be appended
+} PrefixSet;
+
+typedef struct {
+    char literal[PREFIX_MAX_INNER];
+    int length;
+    int min_offset;
+    int max_offset;    // -1: unbounded
+} RequiredLiteral;
+
+// Character classes with more members than this end the prefix
+static const int prefix_max_class_size = 4;
+
+// First-byte sets larger than this, or with more than this many of the
+// most common bytes in text (space, e, t, a, ...), reject too little text
+// to pay for the scan
+static const int prefix_max_first_bytes = 128;
+static const int prefix_max_common_first_bytes = 2;
+
+static void prefix_set_add(PrefixSet *set, const char *literal, int length) {
+    for (int i = 0; i < set->count; i++) {
+        if (set->lengths[i] == length && memcmp(set->literals[i], literal, length) == 0) return;
+    }
+    set->lengths[set->count] = length;
+    memcpy(set->literals[set->count], literal, length);
+    set->count++;
+}
+
+// Bytes a CHAR, DOT or CHARSET node matches - the same set the VMs use,
+// with the flags applied.  Returns how many there are.
+static int prefix_node_bytes(ASTNode *node, int flags, uint8_t *bytes) {
+    ast_byte_set(node, flags, bytes);
+
+    int members = 0;
+    for (int c = 0; c < 256; c++) {
+        if (bytes[c >> 3] & (1 << (c & 7))) members++;
+    }
+    return members;
+}
+
+static void prefix_of(ASTNode *node, int flags, PrefixSet *out) {
+    out->count = 0;
+    out->complete = 0;
+    if (!node) {
+        prefix_set_add(out, "", 0);
+        out->complete = 1;
+        return;
+    }
+
+    switch (node->type) {
+        case AST_CHAR:
+        case AST_CHARSET: {
+            uint8_t bytes[32];
+            int members = prefix_node_bytes(node, flags, bytes);
+            if (flags & 2) {
+                // Literals are kept in lower case: an upper-case letter is its lower case
+                for (int c = 'A'; c <= 'Z'; c++) {
+                    if (!(bytes[c >> 3] & (1 << (c & 7)))) continue;
+                    bytes[c >> 3] &= ~(1 << (c & 7));
+                    if (bytes[(c + 32) >> 3] & (1 << ((c + 32) & 7))) members--;
+                    bytes[(c + 32) >> 3] |= 1 << ((c + 32) & 7);
+                }
+            }
+            if (members == 0 || members > prefix_max_class_size) return;
+
+            for (int c = 0; c < 256; c++) {
+                if (!(bytes[c >> 3] & (1 << (c & 7)))) continue;
+                char byte = (char)c;
+                prefix_set_add(out, &byte, 1);
+            }
+            out->complete = 1;
+            return;
+        }
+
+        case AST_DOT:
+            return;
+
+        case AST_GROUP:
+            prefix_of(node->data.group.content, flags, out);
+            return;
+
+        case AST_SEQUENCE: {
+            prefix_set_add(out, "", 0);
+            out->complete = 1;
+
+            for (int i = 0; i < node->data.sequence.child_count && out->complete; i++) {
+                PrefixSet child;
+                prefix_of(node->data.sequence.children[i], flags, &child);
+                if (child.count == 0 || out->count * child.count > PREFIX_MAX_LITERALS) {
+                    out->complete = 0;
+                    break;
+                }
+
+                PrefixSet joined = {0};
+                joined.complete = child.complete;
+                for (int a = 0; a < out->count; a++) {
+                    for (int b = 0; b < child.count; b++) {
+                        char literal[2 * PREFIX_MAX_LENGTH];
+                        int length = out->lengths[a] + child.lengths[b];
+                        memcpy(literal, out->literals[a], out->lengths[a]);
+                        memcpy(literal + out->lengths[a], child.literals[b], child.lengths[b]);
+                        if (length > PREFIX_MAX_LENGTH) {
+                            length = PREFIX_MAX_LENGTH;
+                            joined.complete = 0;
+                        }
+                        prefix_set_add(&joined, literal, length);
+                    }
+                }
+                *out = joined;
+            }
+            return;
+        }
+
+        case AST_ALTERNATION: {
+            out->complete = 1;
+            for (int i = 0; i < node->data.alternation.alternative_count; i++) {
+                PrefixSet alternative;
+                prefix_of(node->data.alternation.alternatives[i], flags, &alternative);
+                if (alternative.count == 0 || out->count + alternative.count > PREFIX_MAX_LITERALS) {
+                    out->count = 0;
+                    return;
+                }
+                for (int j = 0; j < alternative.count; j++) {
+                    prefix_set_add(out, alternative.literals[j], alternative.lengths[j]);
+                }
+                if (!alternative.complete) out->complete = 0;
+            }
+            return;
+        }
+
+        case AST_QUANTIFIER:
+            if (node->data.quantifier.quantifier == '+' ||
+                (node->data.quantifier.quantifier == '{' && node->data.quantifier.min_count > 0)) {
+                // The first repetition is mandatory; what comes after it is not known
+                prefix_of(node->data.quantifier.target, flags, out);
+                out->complete = 0;
+            } else {
+                prefix_set_add(out, "", 0);
+            }
+            return;
+
+        default:
+            // Assertions match no text
+            prefix_set_add(out, "", 0);
+            out->complete = 1;
+            return;
+    }
+}
+
+// Adds the bytes node can start with to set; returns 1 if node can also
+// match nothing, so whatever follows it contributes too
+static int prefix_first_bytes(ASTNode *node, int flags, uint8_t *set) {
+    if (!node) return 1;
+
+    switch (node->type) {
+        case AST_CHAR:
+        case AST_DOT:
+        case AST_CHARSET: {
+            uint8_t bytes[32];
+            prefix_node_bytes(node, flags, bytes);
+            for (int i = 0; i < 32; i++) set[i] |= bytes[i];
+            return 0;
+        }
+
+        case AST_GROUP:
+            return prefix_first_bytes(node->data.group.content, flags, set);
+
+        case AST_SEQUENCE:
+            for (int i = 0; i < node->data.sequence.child_count; i++) {
+                if (!prefix_first_bytes(node->data.sequence.children[i], flags, set)) return 0;
+            }
+            return 1;
+
+        case AST_ALTERNATION: {
+            int nullable = 0;
+            for (int i = 0; i < node->data.alternation.alternative_count; i++) {
+                if (prefix_first_bytes(node->data.alternation.alternatives[i], flags, set)) nullable = 1;
+            }
+            return nullable;
+        }
+
+        case AST_QUANTIFIER: {
+            int nullable = prefix_first_bytes(node->data.quantifier.target, flags, set);
+            if (node->data.quantifier.quantifier == '+' ||
+                (node->data.quantifier.quantifier == '{' && node->data.quantifier.min_count > 0)) {
+                return nullable;
+            }
+            return 1;
+        }
+
+        default:
+            // Assertions match no text
+            return 1;
+    }
+}
+
+// Shortest and longest text node can match; *max is -1 when unbounded
+static void prefix_length_bounds(ASTNode *node, int *min, int *max) {
+    // Lengths beyond this are as good as unbounded for placing a literal
+    const int limit = 1 << 20;
+    *min = 0;
+    *max = 0;
+    if (!node) return;
+
+    switch (node->type) {
+        case AST_CHAR:
+        case AST_DOT:
+        case AST_CHARSET:
+            *min = *max = 1;
+            return;
+
+        case AST_GROUP:
+            prefix_length_bounds(node->data.group.content, min, max);
+            return;
+
+        case AST_SEQUENCE:
+            for (int i = 0; i < node->data.sequence.child_count; i++) {
+                int child_min, child_max;
+                prefix_length_bounds(node->data.sequence.children[i], &child_min, &child_max);
+                *min = *min + child_min > limit ? limit : *min + child_min;
+                *max = *max < 0 || child_max < 0 || *max + child_max > limit ? -1 : *max + child_max;
+            }
+            return;
+
+        case AST_ALTERNATION:
+            for (int i = 0; i < node->data.alternation.alternative_count; i++) {
+                int alternative_min, alternative_max;
+                prefix_length_bounds(node->data.alternation.alternatives[i], &alternative_min, &alternative_max);
+                if (i == 0 || alternative_min < *min) *min = alternative_min;
+                if (i == 0 || alternative_max < 0 || (*max >= 0 && alternative_max > *max)) *max = alternative_max;
+            }
+            return;
+
+        case AST_QUANTIFIER: {
+            int target_min, target_max;
+            prefix_length_bounds(node->data.quantifier.target, &target_min, &target_max);
+            char quantifier = node->data.quantifier.quantifier;
+            long long low = 0, high = -1;
+            if (quantifier == '+') {
+                low = target_min;
+            } else if (quantifier == '?') {
+                high = target_max;
+            } else if (quantifier == '{') {
+                low = (long long)node->data.quantifier.min_count * target_min;
+                if (node->data.quantifier.max_count >= 0 && target_max >= 0) {
+                    high = (long long)node->data.quantifier.max_count * target_max;
+                }
+            }
+            *min = low > limit ? limit : (int)low;
+            *max = high > limit ? -1 : (int)high;
+            return;
+        }
+
+        default:
+            // Assertions match no text
+            return;
+    }
+}
+
+// Appends the one string node always matches to literal (up to
+// PREFIX_MAX_INNER bytes); returns 0 if node can match more than one string
+static int prefix_exact(ASTNode *node, int flags, char *literal, int *length) {
+    if (!node) return 1;
+
+    switch (node->type) {
+        case AST_CHAR:
+        case AST_CHARSET: {
+            uint8_t bytes[32];
+            if (prefix_node_bytes(node, flags, bytes) != 1) return 0;
+            int c = 0;
+            while (!(bytes[c >> 3] & (1 << (c & 7)))) c++;
+            if (*length < PREFIX_MAX_INNER) literal[(*length)++] = (char)c;
+            return 1;
+        }
+
+        case AST_GROUP:
+            return prefix_exact(node->data.group.content, flags, literal, length);
+
+        case AST_SEQUENCE:
+            for (int i = 0; i < node->data.sequence.child_count; i++) {
+                if (!prefix_exact(node->data.sequence.children[i], flags, literal, length)) return 0;
+            }
+            return 1;
+
+        case AST_DOT:
+        case AST_ALTERNATION:
+        case AST_QUANTIFIER:
+            return 0;
+
+        default:
+            // Assertions add nothing to the string
+            return 1;
+    }
+}
+
+static void prefix_required_candidate(RequiredLiteral *best, const char *literal, int length,
+                                      int min_offset, int max_offset) {
+    // One that always starts the match is covered by the literal prefix
+    if (length <= best->length || max_offset == 0) return;
+    memcpy(best->literal, literal, length);
+    best->length = length;
+    best->min_offset = min_offset;
+    best->max_offset = max_offset;
+}
+
+// Keeps in best the longest literal that every match of node contains,
+// given that node starts between min_base and max_base bytes into the match
+static void prefix_required(ASTNode *node, int flags, RequiredLiteral *best, int min_base, int max_base) {
+    if (!node) return;
+
+    switch (node->type) {
+        case AST_CHAR:
+        case AST_CHARSET: {
+            char literal[PREFIX_MAX_INNER];
+            int length = 0;
+            if (prefix_exact(node, flags, literal, &length)) {
+                prefix_required_candidate(best, literal, length, min_base, max_base);
+            }
+            return;
+        }
+
+        case AST_GROUP:
+            prefix_required(node->data.group.content, flags, best, min_base, max_base);
+            return;
+
+        case AST_SEQUENCE: {
+            // Adjacent fixed strings form one literal; anything else ends it
+            // and may hold a literal of its own
+            char run[PREFIX_MAX_INNER];
+            int run_length = 0;
+            int run_min = 0, run_max = 0;
+            int offset_min = min_base, offset_max = max_base;
+
+            for (int i = 0; i < node->data.sequence.child_count; i++) {
+                ASTNode *child = node->data.sequence.children[i];
+                char literal[PREFIX_MAX_INNER];
+                int length = 0;
+
+                if (prefix_exact(child, flags, literal, &length)) {
+                    if (run_length == 0) {
+                        run_min = offset_min;
+                        run_max = offset_max;
+                    }
+                    for (int j = 0; j < length && run_length < PREFIX_MAX_INNER; j++) run[run_length++] = literal[j];
+                } else {
+                    prefix_required_candidate(best, run, run_length, run_min, run_max);
+                    run_length = 0;
+                    prefix_required(child, flags, best, offset_min, offset_max);
+                }
+
+                int child_min, child_max;
+                prefix_length_bounds(child, &child_min, &child_max);
+                offset_min += child_min;
+                offset_max = offset_max < 0 || child_max < 0 ? -1 : offset_max + child_max;
+            }
+            prefix_required_candidate(best, run, run_length, run_min, run_max);
+            return;
+        }
+
+        case AST_QUANTIFIER:
+            // The first repetition is mandatory and starts where the loop does
+            if (node->data.quantifier.quantifier == '+' ||
+                (node->data.quantifier.quantifier == '{' && node->data.quantifier.min_count > 0)) {
+                prefix_required(node->data.quantifier.target, flags, best, min_base, max_base);
+            }
+            return;
+
+        default:
+            return;
+    }
+}
+
+// Rough commonness of a byte in text: spaces and lowercase letters are
+// everywhere, punctuation like @ or = much rarer
+static int prefix_byte_rank(unsigned char c) {
+    if (c == ' ') return 6;
+    if (c && strchr("etaoinsrhl", c)) return 5;
+    if (c >= 'a' && c <= 'z') return 4;
+    if ((c >= '0' && c <= '9') || c == '\n' || (c && strchr(".,:;-_/\"'", c))) return 3;
+    if (c >= 'A' && c <= 'Z') return 2;
+    return 1;
+}
+
+static void prefix_free(LiteralPrefix *prefix) {
+    if (!prefix) return;
+    free(prefix->single);
+    free(prefix);
+}
+
+// NULL when some match could start with almost anything (or with nothing)
+// at any offset
+static LiteralPrefix* prefix_build(ASTNode *ast, int flags, int anchored_start) {
+    PrefixSet set;
+    prefix_of(ast, flags, &set);
+    for (int i = 0; i < set.count; i++) {
+        if (set.lengths[i] == 0) set.count = 0;
+    }
+
+    uint8_t first_bytes[32] = {0};
+    int nullable = set.count == 0 && prefix_first_bytes(ast, flags, first_bytes);
+    for (int i = 0; i < set.count; i++) {
+        int first = (unsigned char)set.literals[i][0];
+        first_bytes[first >> 3] |= 1 << (first & 7);
+        if ((flags & 2) && first >= 'a' && first <= 'z') first_bytes[(first - 32) >> 3] |= 1 << ((first - 32) & 7);
+    }
+
+    int members = 0;
+    int common = 0;
+    int first_byte = -1;
+    for (int c = 0; c < 256; c++) {
+        if (first_bytes[c >> 3] & (1 << (c & 7))) {
+            members++;
+            if (prefix_byte_rank(c) >= 5) common++;
+            first_byte = c;
+        }
+    }
+    if (nullable || (set.count == 0 && (members > prefix_max_first_bytes || common > prefix_max_common_first_bytes))) {
+        members = 0;
+    }
+
+    RequiredLiteral required = {0};
+    prefix_required(ast, flags, &required, 0, 0);
+
+    if (members == 0 && required.length == 0 && !anchored_start) return NULL;
+
+    LiteralPrefix *prefix = calloc(1, sizeof(LiteralPrefix));
+    if (anchored_start) prefix->anchor = (flags & 8) ? PREFIX_ANCHOR_LINE : PREFIX_ANCHOR_TEXT;
+    prefix->count = set.count;
+    prefix->min_length = set.count > 0 ? PREFIX_MAX_LENGTH : members > 0;
+    for (int i = 0; i < set.count; i++) {
+        prefix->lengths[i] = set.lengths[i];
+        memcpy(prefix->literals[i], set.literals[i], set.lengths[i]);
+        if (set.lengths[i] < prefix->min_length) prefix->min_length = set.lengths[i];
+    }
+    if (set.count > 1) {
+        teddy_init(&prefix->teddy, prefix->literals[0], PREFIX_MAX_LENGTH, prefix->lengths, set.count, flags & 2);
+    }
+    if (members > 0) byte_scanner_init(&prefix->first_bytes, first_bytes);
+    prefix->first_byte_count = members;
+    prefix->first_byte = members == 1 ? first_byte : -1;
+    prefix->fold = (flags & 2) != 0;
+    if (set.count == 1 && set.lengths[0] >= 2) {
+        prefix->single = substring_new(set.literals[0], set.lengths[0], prefix->fold);
+    }
+
+    if (required.length > 0) {
+        memcpy(prefix->inner, required.literal, required.length);
+        prefix->inner_length = required.length;
+        for (int i = 1; i < required.length; i++) {
+            if (prefix_byte_rank((unsigned char)required.literal[i]) <
+                prefix_byte_rank((unsigned char)required.literal[prefix->inner_rare])) {
+                prefix->inner_rare = i;
+            }
+        }
+        prefix->inner_min_offset = required.min_offset;
+        prefix->inner_max_offset = required.max_offset;
+        if (required.min_offset + required.length > prefix->min_length) {
+            prefix->min_length = required.min_offset + required.length;
+        }
+    }
+
+    // No start closer to the end than the shortest match is worth a look
+    int pattern_min, pattern_max;
+    prefix_length_bounds(ast, &pattern_min, &pattern_max);
+    if (pattern_min > prefix->min_length) prefix->min_length = pattern_min;
+    return prefix;
+}
+
+// First occurrence of literal at or after pos, or -1.  memchr looks for
+// the byte at rare, the one least likely to give false hits.
+static int prefix_find_literal(const char *literal, int length, int rare, const char *text, int text_len, int pos) {
+    int last = text_len - length;
+    while (pos <= last) {
+        const char *hit = memchr(text + pos + rare, literal[rare], last - pos + 1);
+        if (!hit) return -1;
+        pos = hit - text - rare;
+        if (memcmp(text + pos, literal, length) == 0) return pos;
+        pos++;
+    }
+    return -1;
+}
+
+// 1 if nothing can match from start_pos on: the required literal does not
+// occur there, or the pattern only matches at offset 0
+static int prefix_rules_out(LiteralPrefix *prefix, const char *text, int text_len, int start_pos) {
+    if (prefix->anchor == PREFIX_ANCHOR_TEXT && start_pos > 0) return 1;
+    if (prefix->inner_length == 0) return 0;
+    int from = start_pos + prefix->inner_min_offset;
+    return prefix_find_literal(prefix->inner, prefix->inner_length, prefix->inner_rare, text, text_len, from) < 0;
+}
+
+// 1 if one of the literals whose bit is set in candidates occurs at pos
+static int prefix_matches_at(LiteralPrefix *prefix, const char *text, int text_len, int pos, uint64_t candidates) {
+    for (int i = 0; i < prefix->count; i++) {
+        if (!(candidates & (1ULL << i))) continue;
+        if (text_len - pos < prefix->lengths[i]) continue;
+        if (!prefix->fold) {
+            if (memcmp(text + pos, prefix->literals[i], prefix->lengths[i]) == 0) return 1;
+            continue;
+        }
+        int k = 0;
+        while (k < prefix->lengths[i] && ascii_fold((unsigned char)text[pos + k]) == (unsigned char)prefix->literals[i][k]) k++;
+        if (k == prefix->lengths[i]) return 1;
+    }
+    return 0;
+}
+
+// compiled->prefix if prefix_find can move past any position, else NULL:
+// automata that consult it at every idle byte skip the call altogether
+static LiteralPrefix* prefix_skipping(CompiledRegex *compiled) {
+    LiteralPrefix *prefix = compiled->prefix;
+    if (prefix && prefix->count == 0 && prefix->first_byte_count == 0 && prefix->inner_max_offset < 0 &&
+        prefix->anchor == PREFIX_ANCHOR_NONE) {
+        return NULL;
+    }
+    return prefix;
+}
+
+// First position >= pos where a match can start: one of the literals (or,
+// with no literals, one of the first bytes) occurs there and, when its
+// distance is bounded, the required literal follows close enough; or -1
+static int prefix_find(LiteralPrefix *prefix, const char *text, int text_len, int pos) {
+    int last = text_len - prefix->min_length;
+    if (prefix->anchor == PREFIX_ANCHOR_TEXT) {
+        // Only offset 0 is left to check; keep the scans below from running on
+        if (pos > 0) return -1;
+        if (last > 0) last = 0;
+    }
+
+    while (pos <= last) {
+        if (prefix->single) {
+            // One literal: its two rarest bytes are checked 16 or 32 starts at a time
+            pos = substring_find(prefix->single, text, last + prefix->lengths[0], pos);
+            if (pos < 0) return -1;
+        } else if (prefix->count > 1) {
+            // Teddy narrows each candidate down to the literals of its buckets
+            int buckets;
+            pos = teddy_find(&prefix->teddy, text, last + prefix->teddy.length, pos, &buckets);
+            if (pos < 0) return -1;
+
+            uint64_t candidates = 0;
+            for (int b = 0; b < TEDDY_BUCKETS; b++) {
+                if (buckets & (1 << b)) candidates |= prefix->teddy.members[b];
+            }
+            if (!prefix_matches_at(prefix, text, text_len, pos, candidates)) {
+                pos++;
+                continue;
+            }
+        } else {
+            if (prefix->first_byte >= 0) {
+                const char *hit = memchr(text + pos, prefix->first_byte, last - pos + 1);
+                if (!hit) return -1;
+                pos = hit - text;
+            } else if (prefix->first_byte_count > 0) {
+                // Large sets often hold the very next byte; skip the scanner setup then
+                unsigned char c = (unsigned char)text[pos];
+                if (!(prefix->first_bytes.set[c >> 3] & (1 << (c & 7)))) {
+                    pos = byte_scan(&prefix->first_bytes, text, last + 1, pos);
+                    if (pos < 0) return -1;
+                }
+            }
+            if (prefix->count == 1 && !prefix_matches_at(prefix, text, text_len, pos, 1)) {
+                pos++;
+                continue;
+            }
+        }
+
+        if (prefix->inner_length > 0 && prefix->inner_max_offset >= 0) {
+            int inner = prefix_find_literal(prefix->inner, prefix->inner_length, prefix->inner_rare,
+                                            text, text_len, pos + prefix->inner_min_offset);
+            if (inner < 0) return -1;
+            if (inner - prefix->inner_max_offset > pos) {
+                pos = inner - prefix->inner_max_offset;
+                continue;
+            }
+        }
+
+        if (prefix->anchor == PREFIX_ANCHOR_LINE && pos > 0 && text[pos - 1] != '\n') {
+            const char *newline = memchr(text + pos, '\n', text_len - pos);
+            if (!newline) return -1;
+            pos = newline - text + 1;
+            continue;
+        }
+        return pos;
+    }
+    return -1;
+}
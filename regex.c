@@ -3,11 +3,34 @@
 #include <string.h>
 #include <ctype.h>
 #include <stdio.h>
+#include <limits.h>
 
 // Forward declaration for AST instruction emission
 int emit_ast_instruction(CompiledRegex *regex, OpCode op);
 // Forward declaration for new lexer+parser (defined in parser.c)
 static ASTNode* parse_pattern(const char *pattern, int *group_counter);
+// Forward declaration for the bit-parallel engine (defined in bitnfa.c)
+static struct BitNFA* bitnfa_build(ASTNode *ast, int flags);
+
+// Forward declaration for the one-pass engine (defined in onepass.c)
+static struct OnePass* onepass_build(CompiledRegex *compiled);
+static struct ThreadedCode* threaded_build(CompiledRegex *compiled);
+// Forward declarations for the compiler (defined in compiler.c)
+static CompiledRegex* compile_forward(ASTNode *ast, int flags);
+static CompiledRegex* regex_reverse(CompiledRegex *compiled);
+// Forward declarations for the planner (defined in planner.c)
+static void plan_route(CompiledRegex *compiled);
+static RegexMatcher plan_exec(const CompiledRegex *compiled);
+// Forward declarations for start-position skipping (defined in prefix.c)
+static struct LiteralPrefix* prefix_build(ASTNode *ast, int flags, int anchored_start);
+static int prefix_find(struct LiteralPrefix *prefix, const char *text, int text_len, int pos);
+static int prefix_rules_out(struct LiteralPrefix *prefix, const char *text, int text_len, int start_pos);
+// Forward declaration for literal alternations (defined in ahocorasick.c)
+static struct AhoCorasick* aho_build(ASTNode *ast, int flags);
+// Forward declarations for single-literal search (defined in substring.c)
+static struct Substring* substring_build(ASTNode *ast, int flags);
+static struct Substring* substring_new(const char *literal, int length, int fold);
+static int substring_find(const struct Substring *sub, const char *text, int text_len, int pos);
 
 // Use the same compilation logic as v2, just change the execution
 // I'll copy the key parts and focus on the VM execution
@@ -24,11 +47,30 @@ static void charset_add_range(uint8_t *charset, char start, char end) {
     }
 }
 
-static int charset_contains(uint8_t *charset, char c) {
+static int charset_contains(const uint8_t *charset, char c) {
     int bit = (unsigned char)c;
     return (charset[bit / 8] & (1 << (bit % 8))) != 0;
 }
 
+// Lower case for ASCII letters, every other byte unchanged.  This is what
+// the i flag folds, whatever the C library's locale says.
+static inline unsigned char ascii_fold(unsigned char c) {
+    return (unsigned char)(c - 'A') < 26 ? c + ('a' - 'A') : c;
+}
+
+// Under i, CHAR and CHARSET are compiled case-folded (a lower-case letter,
+// a class holding both cases of its letters), so matching a byte takes
+// one ascii_fold or nothing at all
+static void charset_fold_case(uint8_t *charset) {
+    for (int c = 'a'; c <= 'z'; c++) {
+        int upper = c - 'a' + 'A';
+        if (charset_contains(charset, (char)c) || charset_contains(charset, (char)upper)) {
+            charset_add_char(charset, (char)c);
+            charset_add_char(charset, (char)upper);
+        }
+    }
+}
+
 // Compiler (simplified - just support basic patterns for now)
 typedef struct {
     const char *pattern;
@@ -78,25 +120,9 @@ static int emit_instruction(CompiledRegex *regex, OpCode op) {
 // Enhanced compilation to handle basic patterns
 // New AST-based compile_regex function
 CompiledRegex* compile_regex(const char *pattern, int flags) {
-    // Handle empty pattern
+    // Handle empty pattern: same program as an empty AST
     if (!pattern || strlen(pattern) == 0) {
-        CompiledRegex *regex = malloc(sizeof(CompiledRegex));
-        regex->code = malloc(sizeof(Instruction) * 4);
-        regex->code_len = 0;
-        regex->code_capacity = 4;
-        regex->group_count = 1;
-        regex->flags = flags;
-        
-        int start_pc = emit_ast_instruction(regex, OP_SAVE_GROUP);
-        regex->code[start_pc].group_num = 0;
-        regex->code[start_pc].is_end = 0;
-        
-        int end_pc = emit_ast_instruction(regex, OP_SAVE_GROUP);
-        regex->code[end_pc].group_num = 0;
-        regex->code[end_pc].is_end = 1;
-        
-        emit_ast_instruction(regex, OP_MATCH);
-        return regex;
+        return compile_ast(NULL, flags);
     }
     
     // NEW: Use lexer + parser approach with proper precedence
@@ -108,8 +134,36 @@ CompiledRegex* compile_regex(const char *pattern, int flags) {
         return NULL; // Parse error
     }
     
-    // Compile AST to bytecode (unchanged)
-    CompiledRegex *compiled = compile_ast(ast, flags);
+    // Compile AST to bytecode; the reverse program waits for a span search
+    CompiledRegex *compiled = compile_forward(ast, flags);
+    compiled->source = strdup(pattern);
+    
+    // Searches jump between the offsets a match can start at: occurrences of
+    // the literal prefix, line starts for ^ under m
+    compiled->prefix = prefix_build(ast, flags, compiled->plan.anchored_start);
+    
+    // A pattern that is one literal is a plain string search
+    compiled->substring = substring_build(ast, flags);
+    
+    // Keyword lists are read once through an Aho-Corasick automaton
+    compiled->aho = aho_build(ast, flags);
+    
+    // Short patterns also get a bit-parallel automaton for yes/no matching
+    compiled->bitnfa = bitnfa_build(ast, flags);
+    
+    // Captures for one-pass programs need no backtracking at all
+    compiled->onepass = onepass_build(compiled);
+    
+    // Everything else backtracks through the threaded interpreter
+    compiled->threaded = threaded_build(compiled);
+    
+#ifdef REGEX_JIT_DEFAULT
+    // Test builds run every pattern through the JIT where it is available
+    regex_jit_compile(compiled);
+#endif
+    
+    // Route calls to the engines that were built
+    plan_route(compiled);
     
     // Clean up AST
     free_ast(ast);
@@ -117,12 +171,149 @@ CompiledRegex* compile_regex(const char *pattern, int flags) {
     return compiled;
 }
 
+// A buffer in a RegexScratch: grown on demand, never shrunk
+typedef struct {
+    void *data;
+    size_t size;
+} ScratchBuffer;
+
+struct RegexScratch {
+    ScratchBuffer visited;      // Backtracking bitset, or the blocks of it in use
+    ScratchBuffer visited_blocks;  // Offset in visited of each block of positions, or -1
+    size_t visited_used;        // Bytes of visited the blocks take
+    size_t visited_block_bytes;
+    int visited_overflow;       // The blocks would have passed REGEX_BACKTRACK_VISITED_LIMIT
+    ScratchBuffer choices;      // Backtracker choice points...
+    ScratchBuffer trail;        // ...what they restore...
+    ScratchBuffer data;         // ...and the positions of SAVE_POINTER
+    ScratchBuffer groups;       // Captures of the running engine
+    ScratchBuffer result;       // Captures of the match handed back
+    ScratchBuffer pike;         // Pike VM thread lists
+    ScratchBuffer stack;        // Pike closure stack, JIT backtrack stack
+    RegexMatcher last_test;     // What the latest calls ran, after per-call fallbacks
+    RegexMatcher last_exec;
+};
+
+// At least bytes of buffer, contents not kept
+static void* scratch_reserve(ScratchBuffer *buffer, size_t bytes) {
+    if (bytes > buffer->size) {
+        size_t size = buffer->size * 2 > bytes ? buffer->size * 2 : bytes;
+        free(buffer->data);
+        buffer->data = malloc(size);
+        buffer->size = size;
+    }
+    return buffer->data;
+}
+
+// At least bytes of buffer, contents kept
+static void* scratch_grow(ScratchBuffer *buffer, size_t bytes) {
+    if (bytes > buffer->size) {
+        size_t size = buffer->size * 2 > bytes ? buffer->size * 2 : bytes;
+        buffer->data = realloc(buffer->data, size);
+        buffer->size = size;
+    }
+    return buffer->data;
+}
+
+RegexScratch* regex_scratch_new(CompiledRegex *compiled) {
+    RegexScratch *scratch = calloc(1, sizeof(RegexScratch));
+    if (compiled) {
+        // What one backtracking start position needs before any choice
+        // point overflows; everything else is sized by its first search
+        scratch_reserve(&scratch->choices, 64 * sizeof(struct ChoicePoint));
+        scratch_reserve(&scratch->groups, 4 * compiled->group_count * sizeof(int));
+        scratch_reserve(&scratch->result, 2 * compiled->group_count * sizeof(int));
+    }
+    return scratch;
+}
+
+RegexMatcher regex_scratch_last_test(const RegexScratch *scratch) {
+    return scratch ? scratch->last_test : REGEX_MATCHER_NONE;
+}
+
+RegexMatcher regex_scratch_last_exec(const RegexScratch *scratch) {
+    return scratch ? scratch->last_exec : REGEX_MATCHER_NONE;
+}
+
+void regex_scratch_free(RegexScratch *scratch) {
+    if (!scratch) return;
+    free(scratch->visited.data);
+    free(scratch->visited_blocks.data);
+    free(scratch->choices.data);
+    free(scratch->trail.data);
+    free(scratch->data.data);
+    free(scratch->groups.data);
+    free(scratch->result.data);
+    free(scratch->pike.data);
+    free(scratch->stack.data);
+    free(scratch);
+}
+
+// The scratch a call runs with: the caller's, or the pattern's own
+static RegexScratch* regex_scratch_for(CompiledRegex *compiled, RegexScratch *scratch) {
+    if (scratch) return scratch;
+    if (!compiled->scratch) compiled->scratch = regex_scratch_new(compiled);
+    return compiled->scratch;
+}
+
+// Backtracking VM for one start position at pos, with no choice points
+// and no captures yet
+static void vm_start(VM *vm, CompiledRegex *compiled, const char *text, int text_len, int pos,
+                     uint8_t *visited, int *visited_blocks, RegexScratch *scratch) {
+    int group_count = compiled->group_count;
+    int capacity = (int)(scratch->choices.size / sizeof(struct ChoicePoint));
+    if (capacity < 64) capacity = 64;
+    int trail_capacity = (int)(scratch->trail.size / sizeof(int));
+    if (trail_capacity < 64) trail_capacity = 64;
+    int data_capacity = (int)(scratch->data.size / sizeof(int));
+    if (data_capacity < 64) data_capacity = 64;
+
+    *vm = (VM){
+        .text = text,
+        .text_len = text_len,
+        .pc = 0,
+        .pos = pos,
+        .data_stack = scratch_grow(&scratch->data, data_capacity * sizeof(int)),
+        .data_top = 0,
+        .data_capacity = data_capacity,
+        .data_floor = 0,
+        .choice_stack = scratch_grow(&scratch->choices, capacity * sizeof(struct ChoicePoint)),
+        .choice_top = 0,
+        .choice_capacity = capacity,
+        .trail = scratch_grow(&scratch->trail, trail_capacity * sizeof(int)),
+        .trail_top = 0,
+        .trail_capacity = trail_capacity,
+        .scratch = scratch,
+        .visited = visited,
+        .visited_blocks = visited_blocks,
+        .choice_count = 0,
+        .max_choices = INT_MAX,
+        .flags = compiled->flags,
+        .last_match_was_zero_length = 0,
+        .last_operation_success = 0,
+        .group_count = group_count
+    };
+
+    vm->group_starts = scratch_reserve(&scratch->groups, 2 * group_count * sizeof(int));
+    vm->group_ends = vm->group_starts + group_count;
+    for (int i = 0; i < 2 * group_count; i++) vm->group_starts[i] = -1;
+}
+
+// Log a value about to be overwritten; slot as in VM.trail
+static inline void vm_trail(VM *vm, int slot, int old_value) {
+    if (vm->trail_top + 2 > vm->trail_capacity) {
+        vm->trail_capacity *= 2;
+        vm->trail = scratch_grow(&vm->scratch->trail, vm->trail_capacity * sizeof(int));
+    }
+    vm->trail[vm->trail_top++] = slot;
+    vm->trail[vm->trail_top++] = old_value;
+}
+
 // VM execution with simplified integer data stack
 static void push_choice(VM *vm, int alt_pc) {
     if (vm->choice_top >= vm->choice_capacity) {
         vm->choice_capacity *= 2;
-        vm->choice_stack = realloc(vm->choice_stack, 
-                                 vm->choice_capacity * sizeof(struct ChoicePoint));
+        vm->choice_stack = scratch_grow(&vm->scratch->choices, vm->choice_capacity * sizeof(struct ChoicePoint));
     }
     
     struct ChoicePoint *cp = &vm->choice_stack[vm->choice_top++];
@@ -130,17 +321,13 @@ static void push_choice(VM *vm, int alt_pc) {
     cp->pos = vm->pos;
     cp->flags = vm->flags;
     cp->last_operation_success = vm->last_operation_success;
-    cp->transferred = 0;  // Not transferred yet
+    cp->trail_top = vm->trail_top;
     
-    // Take immutable snapshot of integer data stack - ALWAYS retain when storing
-    cp->data_stack = vm->data_stack;
-    int_stack_retain(cp->data_stack);
-    
-    // Copy capture groups
-    cp->group_starts = malloc(vm->group_count * sizeof(int));
-    cp->group_ends = malloc(vm->group_count * sizeof(int));
-    memcpy(cp->group_starts, vm->group_starts, vm->group_count * sizeof(int));
-    memcpy(cp->group_ends, vm->group_ends, vm->group_count * sizeof(int));
+    // The data stack is kept by its height; entries up to it must survive
+    // until this choice point is popped
+    cp->data_top = vm->data_top;
+    cp->data_floor = vm->data_floor;
+    if (vm->data_top > vm->data_floor) vm->data_floor = vm->data_top;
 }
 
 static int pop_choice(VM *vm) {
@@ -155,155 +342,463 @@ static int pop_choice(VM *vm) {
     vm->flags = cp->flags;
     vm->last_operation_success = cp->last_operation_success;
     
-    // Restore immutable integer data stack - transfer ownership
-    int_stack_release(vm->data_stack);        // Release current VM stack
-    vm->data_stack = cp->data_stack;          // Transfer ownership - don't release!
-    cp->transferred = 1;                      // Mark as transferred
-    
-    // Restore capture groups
-    memcpy(vm->group_starts, cp->group_starts, vm->group_count * sizeof(int));
-    memcpy(vm->group_ends, cp->group_ends, vm->group_count * sizeof(int));
-    
-    free(cp->group_starts);
-    free(cp->group_ends);
+    // Undo what was overwritten since the choice point, newest first
+    while (vm->trail_top > cp->trail_top) {
+        vm->trail_top -= 2;
+        int slot = vm->trail[vm->trail_top];
+        if (slot >= 0) {
+            vm->group_starts[slot] = vm->trail[vm->trail_top + 1];
+        } else {
+            vm->data_stack[-slot - 1] = vm->trail[vm->trail_top + 1];
+        }
+    }
+    vm->data_top = cp->data_top;
+    vm->data_floor = cp->data_floor;
     
     return 1;
 }
 
+// SAVE_GROUP: set a capture, logging its old value while a choice point
+// is open to restore it.  With none open there is nothing to go back to.
+static inline void vm_save_group(VM *vm, int group_num, int is_end, int pos) {
+    int slot = is_end ? vm->group_count + group_num : group_num;
+    if (vm->choice_top > 0) vm_trail(vm, slot, vm->group_starts[slot]);
+    vm->group_starts[slot] = pos;
+}
+
+// SAVE_POINTER: push a position.  An entry below data_floor is one a
+// choice point will truncate back to, so its old value goes on the trail.
+static inline void vm_push_position(VM *vm, int pos) {
+    if (vm->data_top >= vm->data_capacity) {
+        vm->data_capacity *= 2;
+        vm->data_stack = scratch_grow(&vm->scratch->data, vm->data_capacity * sizeof(int));
+    }
+    if (vm->data_top < vm->data_floor) vm_trail(vm, -vm->data_top - 1, vm->data_stack[vm->data_top]);
+    vm->data_stack[vm->data_top++] = pos;
+}
+
+// RESTORE_POSITION: pop a position, 0 from an empty stack
+static inline int vm_pop_position(VM *vm) {
+    return vm->data_top > 0 ? vm->data_stack[--vm->data_top] : 0;
+}
+
+// Size of the visited bitset for one backtracking search over text_len
+// bytes: two bits per (pc, pos), rounded up to whole 64-bit words
+static long long backtrack_visited_bytes(CompiledRegex *compiled, int text_len) {
+    long long bits = (long long)compiled->code_len * (text_len + 1) * 2;
+    return (bits + 63) / 64 * 8;
+}
+
+// A cleared bitset in the scratch, or NULL when it would exceed
+// REGEX_BACKTRACK_VISITED_LIMIT or the plan keeps it in blocks
+static uint8_t* backtrack_visited(CompiledRegex *compiled, int text_len, RegexScratch *scratch) {
+    long long bytes = backtrack_visited_bytes(compiled, text_len);
+    if (bytes > REGEX_BACKTRACK_VISITED_LIMIT || compiled->plan.visited_blocks) return NULL;
+    uint8_t *visited = scratch_reserve(&scratch->visited, bytes);
+    memset(visited, 0, bytes);
+    return visited;
+}
+
+// Texts too long for one bitset, and patterns planned with visited_blocks,
+// keep it in blocks of VISITED_BLOCK positions, every pc of each, allocated when the search first reaches them
+#define VISITED_BLOCK 256
+
+// The block table for one search, with no block allocated yet
+static int* backtrack_visited_blocks(CompiledRegex *compiled, int text_len, RegexScratch *scratch) {
+    int block_count = text_len / VISITED_BLOCK + 1;
+    int *blocks = scratch_reserve(&scratch->visited_blocks, block_count * sizeof(int));
+    memset(blocks, 0xff, block_count * sizeof(int));
+    scratch->visited_used = 0;
+    scratch->visited_block_bytes = (size_t)compiled->code_len * VISITED_BLOCK * 2 / 8;
+    scratch->visited_overflow = 0;
+    return blocks;
+}
+
+// Offset of a new cleared block, or -1 once the blocks would pass
+// REGEX_BACKTRACK_VISITED_LIMIT
+static int visited_block_new(RegexScratch *scratch) {
+    size_t bytes = scratch->visited_block_bytes;
+    if (scratch->visited_used + bytes > REGEX_BACKTRACK_VISITED_LIMIT) {
+        scratch->visited_overflow = 1;
+        return -1;
+    }
+    uint8_t *blocks = scratch_grow(&scratch->visited, scratch->visited_used + bytes);
+    memset(blocks + scratch->visited_used, 0, bytes);
+    int offset = (int)scratch->visited_used;
+    scratch->visited_used += bytes;
+    return offset;
+}
+
+// Mark (pc, pos, flag) explored; 1 if it already was.  Past the memory
+// limit every state counts as explored, which ends the search quickly, and
+// the caller sees visited_overflow and discards what it found.
+static inline int vm_visit(VM *vm, int pc, int pos, int flag) {
+    uint8_t *bits = vm->visited;
+    int bit;
+    if (bits) {
+        bit = ((pc * (vm->text_len + 1) + pos) << 1) | flag;
+    } else {
+        int *offset = &vm->visited_blocks[pos / VISITED_BLOCK];
+        if (*offset < 0 && (*offset = visited_block_new(vm->scratch)) < 0) return 1;
+        bits = (uint8_t *)vm->scratch->visited.data + *offset;
+        bit = ((pc * VISITED_BLOCK + pos % VISITED_BLOCK) << 1) | flag;
+    }
+    if (bits[bit >> 3] & (1 << (bit & 7))) return 1;
+    bits[bit >> 3] |= 1 << (bit & 7);
+    return 0;
+}
+
+// A match of a pattern ending at $ outside multiline mode ends at
+// text_len, so with a bounded length it starts within max_length of it
+static int regex_window_start(CompiledRegex *compiled, int text_len, int start_pos) {
+    if (!compiled->plan.anchored_end || (compiled->flags & 8) || compiled->max_length < 0) return start_pos;
+    return text_len - compiled->max_length > start_pos ? text_len - compiled->max_length : start_pos;
+}
+
+// 0 when the pattern's literal suffix is not what the text ends with, so
+// a pattern ending at $ outside multiline mode cannot match
+static int regex_suffix_matches(CompiledRegex *compiled, const char *text, int text_len) {
+    RegexPlan *plan = &compiled->plan;
+    const char *tail = text + text_len - plan->suffix_length;
+    if (!(compiled->flags & 2)) return memcmp(tail, plan->suffix, plan->suffix_length) == 0;
+    for (int i = 0; i < plan->suffix_length; i++) {
+        unsigned char c = (unsigned char)tail[i];
+        if ((c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c) != (unsigned char)plan->suffix[i]) return 0;
+    }
+    return 1;
+}
+
 #include "execute.c" // AMALGAMATE
 
+#include "pike.c" // AMALGAMATE
+
+#include "scan.c" // AMALGAMATE
+
+#include "teddy.c" // AMALGAMATE
+
+#include "prefix.c" // AMALGAMATE
+
+#include "substring.c" // AMALGAMATE
+
+#include "threaded.c" // AMALGAMATE
+
+#include "dfa.c" // AMALGAMATE
+
+#include "full_dfa.c" // AMALGAMATE
+
+#include "bitnfa.c" // AMALGAMATE
+
+#include "ahocorasick.c" // AMALGAMATE
+
+#include "onepass.c" // AMALGAMATE
+
+#include "jit.c" // AMALGAMATE
+
+#include "planner.c" // AMALGAMATE
+
 // New function that returns detailed match information
 typedef struct {
     int matched;
     int match_start;
     int match_end;
-    int *group_starts;
+    int *group_starts;        // In the scratch, valid until its next search
     int *group_ends;
     int group_count;
 } DetailedMatch;
 
-DetailedMatch execute_regex_detailed(CompiledRegex *compiled, const char *text, int start_pos) {
+static DetailedMatch search_detailed(CompiledRegex *compiled, const char *text, int text_len, int start_pos,
+                                     RegexScratch *scratch);
+
+// The scratch's result array for group_count captures
+static void detailed_captures(DetailedMatch *result, RegexScratch *scratch, int group_count) {
+    result->group_count = group_count;
+    result->group_starts = scratch_reserve(&scratch->result, 2 * group_count * sizeof(int));
+    result->group_ends = result->group_starts + group_count;
+}
+
+DetailedMatch execute_regex_detailed(CompiledRegex *compiled, const char *text, int start_pos, RegexScratch *scratch) {
     DetailedMatch result = {0};
     if (!compiled || !text) return result;
+    return search_detailed(compiled, text, strlen(text), start_pos, scratch);
+}
+
+// execute_regex_detailed on a text whose length is known
+static DetailedMatch search_detailed(CompiledRegex *compiled, const char *text, int text_len, int start_pos,
+                                     RegexScratch *scratch) {
+    DetailedMatch result = {0};
+    scratch = regex_scratch_for(compiled, scratch);
     
-    int text_len = strlen(text);
+    RegexPlan *plan = &compiled->plan;
+    
+    // Too little text left for the shortest match
+    if (text_len - start_pos < compiled->min_length) {
+        scratch->last_exec = REGEX_MATCHER_NONE;
+        return result;
+    }
+    start_pos = regex_window_start(compiled, text_len, start_pos);
+    if (plan->from_end && !regex_suffix_matches(compiled, text, text_len)) {
+        scratch->last_exec = REGEX_MATCHER_NONE;
+        return result;
+    }
     
-    for (int pos = start_pos; pos <= text_len; pos++) {
-        VM vm = {
-            .text = text,
-            .text_len = text_len,
-            .pc = 0,
-            .pos = pos,
-            .data_stack = int_stack_new(),
-            .choice_stack = malloc(64 * sizeof(struct ChoicePoint)),
-            .choice_top = 0,
-            .choice_capacity = 64,
-            .choice_count = 0,
-            .max_choices = 10000,
-            .flags = compiled->flags,
-            .last_match_was_zero_length = 0,
-            .last_operation_success = 0,
-            .group_count = compiled->group_count
-        };
+    // The pattern is one literal: its occurrences are the matches
+    if (plan->exec == REGEX_MATCHER_SUBSTRING) {
+        scratch->last_exec = REGEX_MATCHER_SUBSTRING;
+        int found = substring_find(compiled->substring, text, text_len, start_pos);
+        if (found < 0) return result;
+        
+        result.matched = 1;
+        result.match_start = found;
+        result.match_end = found + compiled->substring->length;
+        detailed_captures(&result, scratch, 1);
+        result.group_starts[0] = result.match_start;
+        result.group_ends[0] = result.match_end;
+        return result;
+    }
+    
+    if (!plan->from_end && compiled->prefix && prefix_rules_out(compiled->prefix, text, text_len, start_pos)) {
+        scratch->last_exec = REGEX_MATCHER_NONE;
+        return result;
+    }
+    
+    // Keyword lists: the automaton gives the span, which is every group there is
+    if (plan->exec == REGEX_MATCHER_AHO_CORASICK) {
+        scratch->last_exec = REGEX_MATCHER_AHO_CORASICK;
+        int span_start, span_end;
+        if (!aho_search(compiled->aho, prefix_skipping(compiled), text, text_len, start_pos, &span_start, &span_end)) {
+            return result;
+        }
         
-        // Initialize capture groups
-        vm.group_starts = malloc(compiled->group_count * sizeof(int));
-        vm.group_ends = malloc(compiled->group_count * sizeof(int));
+        result.matched = 1;
+        result.match_start = span_start;
+        result.match_end = span_end;
+        detailed_captures(&result, scratch, compiled->group_count);
         for (int i = 0; i < compiled->group_count; i++) {
-            vm.group_starts[i] = -1;
-            vm.group_ends[i] = -1;
+            result.group_starts[i] = span_start;
+            result.group_ends[i] = span_end;
+        }
+        return result;
+    }
+    
+    // Three-phase search: the lazy DFAs find where the leftmost match starts
+    // (or that there is none) in linear time, so the capture engines below
+    // only run from that position.  Matches that end at the end of the text
+    // are found by the reverse scan alone.
+    if (plan->find_span) {
+        int span_start, span_end;
+        int found = plan->from_end ? dfa_search_from_end(compiled, text, text_len, start_pos, &span_start, &span_end)
+                                   : dfa_search_span(compiled, text, text_len, start_pos, &span_start, &span_end);
+        if (found == 0 || (found > 0 && plan->span_only)) {
+            scratch->last_exec = plan->from_end ? REGEX_MATCHER_REVERSE_DFA : REGEX_MATCHER_SPAN_DFA;
+            if (found == 0) return result;
+            
+            result.matched = 1;
+            result.match_start = span_start;
+            result.match_end = span_end;
+            detailed_captures(&result, scratch, 1);
+            result.group_starts[0] = span_start;
+            result.group_ends[0] = span_end;
+            return result;
+        }
+        if (found > 0) start_pos = span_start;
+    }
+    
+    // An engine chosen on the CompiledRegex after compilation wins over the
+    // plan, and a pinned matcher over both
+    RegexMatcher matcher = plan_exec(compiled);
+    
+    // Shared by every start position: states that failed from one start fail
+    // from all.  Texts too long for one bitset are searched by the
+    // interpreter, which can keep it in blocks, as the plan may ask for.
+    uint8_t *visited = NULL;
+    int *visited_blocks = NULL;
+    if (matcher != REGEX_MATCHER_PIKE) {
+        visited = backtrack_visited(compiled, text_len, scratch);
+        if (!visited) {
+            visited_blocks = backtrack_visited_blocks(compiled, text_len, scratch);
+            matcher = REGEX_MATCHER_BACKTRACK;
+        }
+    }
+    scratch->last_exec = matcher;
+    
+    // Native code from regex_jit_compile, then one-pass programs, which
+    // record captures in a single forward scan
+    if (matcher != REGEX_MATCHER_BACKTRACK) {
+        detailed_captures(&result, scratch, compiled->group_count);
+        int matched;
+        if (matcher == REGEX_MATCHER_PIKE) {
+            matched = pike_execute(compiled, text, text_len, start_pos, result.group_starts, result.group_ends, scratch);
+        } else if (matcher == REGEX_MATCHER_JIT) {
+            matched = jit_execute(compiled, text, text_len, start_pos, visited, result.group_starts, result.group_ends,
+                                  scratch);
+        } else {
+            matched = onepass_execute(compiled, text, text_len, start_pos, visited, result.group_starts,
+                                      result.group_ends, scratch);
         }
         
-        int match_result = execute(compiled, &vm);
+        if (matched > 0) {
+            result.matched = 1;
+            result.match_start = result.group_starts[0];
+            result.match_end = result.group_ends[0];
+            return result;
+        }
+        
+        // Negative only when the JIT ran out of stack: the interpreter takes over
+        if (matched == 0) return result;
+        scratch->last_exec = REGEX_MATCHER_BACKTRACK;
+    }
+    
+    for (int pos = start_pos; pos <= text_len - compiled->min_length; pos++) {
+        // No match can start before the next occurrence of the prefix
+        if (compiled->prefix && (pos = prefix_find(compiled->prefix, text, text_len, pos)) < 0) break;
+        
+        VM vm;
+        vm_start(&vm, compiled, text, text_len, pos, visited, visited_blocks, scratch);
+        int match_result = run_backtracker(compiled, &vm);
+        if (visited_blocks && scratch->visited_overflow) break;
         
         if (match_result) {
             // Success - copy group data
             result.matched = 1;
             result.match_start = pos;
             result.match_end = vm.group_ends[0];  // Group 0 is the full match
-            result.group_count = compiled->group_count;
-            result.group_starts = malloc(compiled->group_count * sizeof(int));
-            result.group_ends = malloc(compiled->group_count * sizeof(int));
+            detailed_captures(&result, scratch, compiled->group_count);
             memcpy(result.group_starts, vm.group_starts, compiled->group_count * sizeof(int));
             memcpy(result.group_ends, vm.group_ends, compiled->group_count * sizeof(int));
         }
         
-        // Clean up VM
-        int_stack_release(vm.data_stack);
-        for (int i = 0; i < vm.choice_top; i++) {
-            struct ChoicePoint *cp = &vm.choice_stack[i];
-            if (!cp->transferred) {
-                int_stack_release(cp->data_stack);
-            }
-            free(cp->group_starts);
-            free(cp->group_ends);
+        if (match_result) break;
+    }
+    
+    // The blocks outgrew their limit, so states were cut short: the Pike VM
+    // follows the same states without a visited set
+    if (visited_blocks && scratch->visited_overflow) {
+        scratch->last_exec = REGEX_MATCHER_PIKE;
+        detailed_captures(&result, scratch, compiled->group_count);
+        result.matched = pike_execute(compiled, text, text_len, start_pos, result.group_starts, result.group_ends,
+                                      scratch);
+        if (result.matched) {
+            result.match_start = result.group_starts[0];
+            result.match_end = result.group_ends[0];
         }
-        free(vm.choice_stack);
-        free(vm.group_starts);
-        free(vm.group_ends);
-        
-        if (match_result) return result;
     }
     
     return result;
 }
 
 int execute_regex(CompiledRegex *compiled, const char *text, int start_pos) {
+    return execute_regex_scratch(compiled, text, start_pos, NULL);
+}
+
+int execute_regex_scratch(CompiledRegex *compiled, const char *text, int start_pos, RegexScratch *scratch) {
     if (!compiled || !text) return 0;
     
     int text_len = strlen(text);
+    RegexPlan *plan = &compiled->plan;
+    scratch = regex_scratch_for(compiled, scratch);
+    scratch->last_test = plan->test;
     
-    for (int pos = start_pos; pos <= text_len; pos++) {
-        VM vm = {
-            .text = text,
-            .text_len = text_len,
-            .pc = 0,
-            .pos = pos,
-            .data_stack = int_stack_new(),
-            .choice_stack = malloc(64 * sizeof(struct ChoicePoint)),
-            .choice_top = 0,
-            .choice_capacity = 64,
-            .choice_count = 0,
-            .max_choices = 10000,
-            .flags = compiled->flags,
-            .last_match_was_zero_length = 0,
-            .last_operation_success = 0,
-            .group_count = compiled->group_count
-        };
-        
-        // Initialize capture groups
-        vm.group_starts = malloc(compiled->group_count * sizeof(int));
-        vm.group_ends = malloc(compiled->group_count * sizeof(int));
-        for (int i = 0; i < compiled->group_count; i++) {
-            vm.group_starts[i] = -1;
-            vm.group_ends[i] = -1;
-        }
-        
-        int result = execute(compiled, &vm);
+    if (text_len - start_pos < compiled->min_length) {
+        scratch->last_test = REGEX_MATCHER_NONE;
+        return 0;
+    }
+    start_pos = regex_window_start(compiled, text_len, start_pos);
+    
+    // Matches that end at the end of the text end with the literal suffix
+    if (plan->from_end && !regex_suffix_matches(compiled, text, text_len)) {
+        scratch->last_test = REGEX_MATCHER_NONE;
+        return 0;
+    }
+    
+    if (plan->test == REGEX_MATCHER_SUBSTRING) {
+        return substring_find(compiled->substring, text, text_len, start_pos) >= 0;
+    }
+    
+    // Every match contains the required literal; without it there is nothing
+    // to run.  A scan from the end would read less than the search for it.
+    if (!plan->from_end && compiled->prefix && prefix_rules_out(compiled->prefix, text, text_len, start_pos)) {
+        scratch->last_test = REGEX_MATCHER_NONE;
+        return 0;
+    }
+    
+    if (plan->test == REGEX_MATCHER_AHO_CORASICK) {
+        return aho_search(compiled->aho, prefix_skipping(compiled), text, text_len, start_pos, NULL, NULL);
+    }
+    
+    // Precompiled table walk when compile_regex_dfa built one
+    if (plan->test == REGEX_MATCHER_FULL_DFA) {
+        return full_dfa_search(compiled->full_dfa, prefix_skipping(compiled), text, text_len, start_pos);
+    }
+    
+    // Patterns ending at $: read back from the end until a start is found
+    if (plan->test == REGEX_MATCHER_REVERSE_DFA) {
+        int found = dfa_search_from_end(compiled, text, text_len, start_pos, NULL, NULL);
+        if (found >= 0) return found;
+        scratch->last_test = REGEX_MATCHER_LAZY_DFA;
+    }
+    
+    // Bit-parallel NFA when the pattern fits in 64 positions
+    if (plan->test == REGEX_MATCHER_BITNFA) {
+        return bitnfa_search(compiled->bitnfa, prefix_skipping(compiled), text, text_len, start_pos);
+    }
+    
+    // Yes/no answers need no captures: try the lazy DFA before any VM
+    int dfa_result = dfa_search(compiled, text, text_len, start_pos);
+    if (dfa_result >= 0) return dfa_result;
+    
+    if (compiled->engine == REGEX_ENGINE_PIKE) {
+        scratch->last_test = REGEX_MATCHER_PIKE;
+        return pike_execute(compiled, text, text_len, start_pos, NULL, NULL, scratch);
+    }
+    
+    uint8_t *visited = backtrack_visited(compiled, text_len, scratch);
+    int *visited_blocks = visited ? NULL : backtrack_visited_blocks(compiled, text_len, scratch);
+    
+    if (compiled->jit && visited) {
+        scratch->last_test = REGEX_MATCHER_JIT;
+        int matched = jit_execute(compiled, text, text_len, start_pos, visited, NULL, NULL, scratch);
+        if (matched >= 0) return matched;
+    }
+    scratch->last_test = REGEX_MATCHER_BACKTRACK;
+    
+    for (int pos = start_pos; pos <= text_len - compiled->min_length; pos++) {
+        // No match can start before the next occurrence of the prefix
+        if (compiled->prefix && (pos = prefix_find(compiled->prefix, text, text_len, pos)) < 0) break;
         
-        // Cleanup
-        int_stack_release(vm.data_stack);
-        for (int i = 0; i < vm.choice_top; i++) {
-            // Only release if not transferred back to VM
-            if (!vm.choice_stack[i].transferred) {
-                int_stack_release(vm.choice_stack[i].data_stack);
-            }
-            free(vm.choice_stack[i].group_starts);
-            free(vm.choice_stack[i].group_ends);
-        }
-        free(vm.choice_stack);
-        free(vm.group_starts);
-        free(vm.group_ends);
+        VM vm;
+        vm_start(&vm, compiled, text, text_len, pos, visited, visited_blocks, scratch);
+        int result = run_backtracker(compiled, &vm);
+        if (visited_blocks && scratch->visited_overflow) break;
         
         if (result) return 1;
     }
     
+    // As in execute_regex_detailed, a search cut short by the block limit
+    // is answered by the Pike VM
+    if (visited_blocks && scratch->visited_overflow) {
+        scratch->last_test = REGEX_MATCHER_PIKE;
+        return pike_execute(compiled, text, text_len, start_pos, NULL, NULL, scratch);
+    }
     return 0;
 }
 
 void free_regex(CompiledRegex *compiled) {
     if (compiled) {
         free(compiled->code);
+        free(compiled->charsets);
+        dfa_free(compiled->dfa);
+        full_dfa_free(compiled->full_dfa);
+        bitnfa_free(compiled->bitnfa);
+        onepass_free(compiled->onepass);
+        jit_free(compiled->jit);
+        threaded_free(compiled->threaded);
+        dfa_free(compiled->span_dfa);
+        prefix_free(compiled->prefix);
+        aho_free(compiled->aho);
+        free(compiled->substring);
+        regex_scratch_free(compiled->scratch);
+        free_regex(compiled->reverse);
+        free(compiled->source);
         free(compiled);
     }
 }
@@ -318,7 +813,7 @@ void print_regex_bytecode(CompiledRegex *compiled) {
             case OP_CHARSET: 
                 printf("CHARSET%s [", compiled->code[i].negate ? " (negated)" : "");
                 for (int j = 0; j < 256; j++) {
-                    if (compiled->code[i].charset[j / 8] & (1 << (j % 8))) {
+                    if (compiled->charsets[compiled->code[i].charset][j / 8] & (1 << (j % 8))) {
                         if (j >= 32 && j < 127) {
                             printf("%c", j);
                         } else {
@@ -373,37 +868,67 @@ RegExp* regex_new(const char *pattern, const char *flags) {
 }
 
 int regex_test(RegExp *regexp, const char *text) {
+    return regex_test_scratch(regexp, text, NULL);
+}
+
+int regex_test_scratch(RegExp *regexp, const char *text, RegexScratch *scratch) {
     if (!regexp || !regexp->compiled || !text) return 0;
-    return execute_regex(regexp->compiled, text, 0);
+    return execute_regex_scratch(regexp->compiled, text, 0, scratch);
 }
 
 MatchResult* regex_exec(RegExp *regexp, const char *text) {
-    if (!regexp || !regexp->compiled || !text) return NULL;
+    return regex_exec_scratch(regexp, text, NULL);
+}
+
+// One regex_exec step: the next match from last_index under g, from 0
+// otherwise, with last_index moved past it
+static DetailedMatch exec_detailed(RegExp *regexp, const char *text, int text_len, RegexScratch *scratch) {
+    DetailedMatch detailed = {0};
     
     // Check if this is a global regex and should continue from last_index
     int start_pos = 0;
     if (regexp->compiled->flags & 4) { // Global flag 'g'
         start_pos = regexp->last_index;
         
-        // If last_index is beyond the text, return NULL (no more matches)
-        if (start_pos >= (int)strlen(text)) {
-            return NULL;
+        // If last_index is beyond the text, return no match (no more matches)
+        if (start_pos >= text_len) {
+            return detailed;
         }
     }
     
-    DetailedMatch detailed = execute_regex_detailed(regexp->compiled, text, start_pos);
+    detailed = search_detailed(regexp->compiled, text, text_len, start_pos, scratch);
     if (!detailed.matched) {
         // For global regex, reset last_index when no match found
         if (regexp->compiled->flags & 4) {
             regexp->last_index = 0;
         }
-        return NULL;
+        return detailed;
     }
     
     // For global regex, update last_index to end of this match
     if (regexp->compiled->flags & 4) {
         regexp->last_index = detailed.match_end;
     }
+    return detailed;
+}
+
+// Copy the captures of a match into spans, -1 for groups that took no part
+static void detailed_spans(DetailedMatch *detailed, MatchSpan *spans) {
+    for (int i = 0; i < detailed->group_count; i++) {
+        if (detailed->group_starts[i] >= 0 && detailed->group_ends[i] >= 0) {
+            spans[i].start = detailed->group_starts[i];
+            spans[i].end = detailed->group_ends[i];
+        } else {
+            spans[i].start = spans[i].end = -1;
+        }
+    }
+}
+
+MatchResult* regex_exec_scratch(RegExp *regexp, const char *text, RegexScratch *scratch) {
+    if (!regexp || !regexp->compiled || !text) return NULL;
+    
+    DetailedMatch detailed = exec_detailed(regexp, text, strlen(text), scratch);
+    if (!detailed.matched) return NULL;
     
     // Create MatchResult with captured groups
     MatchResult *match = malloc(sizeof(MatchResult));
@@ -424,13 +949,38 @@ MatchResult* regex_exec(RegExp *regexp, const char *text) {
         }
     }
     
-    // Clean up detailed match
-    free(detailed.group_starts);
-    free(detailed.group_ends);
+    return match;
+}
+
+MatchSpans* regex_exec_spans(RegExp *regexp, const char *text, RegexScratch *scratch) {
+    if (!regexp || !regexp->compiled || !text) return NULL;
     
+    DetailedMatch detailed = exec_detailed(regexp, text, strlen(text), scratch);
+    if (!detailed.matched) return NULL;
+    
+    // One block: the header, then the spans
+    MatchSpans *match = malloc(sizeof(MatchSpans) + detailed.group_count * sizeof(MatchSpan));
+    match->text = text;
+    match->group_count = detailed.group_count;
+    match->spans = (MatchSpan *)(match + 1);
+    detailed_spans(&detailed, match->spans);
     return match;
 }
 
+char* match_spans_group(const MatchSpans *match, int group) {
+    if (!match || group < 0 || group >= match->group_count || match->spans[group].start < 0) return NULL;
+    
+    int len = match->spans[group].end - match->spans[group].start;
+    char *str = malloc(len + 1);
+    memcpy(str, match->text + match->spans[group].start, len);
+    str[len] = '\0';
+    return str;
+}
+
+void match_spans_free(MatchSpans *match) {
+    free(match);
+}
+
 void regex_free(RegExp *regexp) {
     if (regexp) {
         if (regexp->compiled) free_regex(regexp->compiled);
@@ -499,6 +1049,57 @@ void match_iterator_free(MatchIterator *iter) {
     }
 }
 
+MatchSpanIterator* string_match_all_spans(const char *text, RegExp *regexp) {
+    if (!text || !regexp) return NULL;
+    
+    // Like matchAll, this requires the global flag
+    if (!(regexp->compiled->flags & 4)) {
+        return NULL;
+    }
+    
+    MatchSpanIterator *iter = malloc(sizeof(MatchSpanIterator));
+    iter->regexp = regexp;
+    iter->text = text;
+    iter->text_len = strlen(text);
+    iter->pos = 0;
+    iter->done = 0;
+    iter->match.text = text;
+    iter->match.group_count = 0;
+    iter->match.spans = malloc(regexp->compiled->group_count * sizeof(MatchSpan));
+    
+    return iter;
+}
+
+const MatchSpans* match_span_iterator_next(MatchSpanIterator *iter) {
+    if (!iter || iter->done) return NULL;
+    
+    // The same stopping rule as regex_exec under g
+    if (iter->pos >= iter->text_len) {
+        iter->done = 1;
+        return NULL;
+    }
+    
+    DetailedMatch detailed = search_detailed(iter->regexp->compiled, iter->text, iter->text_len, iter->pos, NULL);
+    if (!detailed.matched) {
+        iter->done = 1;
+        return NULL;
+    }
+    
+    iter->match.group_count = detailed.group_count;
+    detailed_spans(&detailed, iter->match.spans);
+    
+    // Step over an empty match so the next search does not find it again
+    iter->pos = detailed.match_end > detailed.match_start ? detailed.match_end : detailed.match_end + 1;
+    return &iter->match;
+}
+
+void match_span_iterator_free(MatchSpanIterator *iter) {
+    if (iter) {
+        free(iter->match.spans);
+        free(iter);
+    }
+}
+
 // AST Implementation
 
 ASTNode* create_ast_node(ASTNodeType type) {
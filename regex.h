@@ -1,7 +1,6 @@
 #ifndef REGEX_H
 #define REGEX_H
 
-#include "int_stack.h"
 #include <stdint.h>
 
 // AST Node Types for parsing
@@ -70,19 +69,17 @@ typedef enum {
     OP_FAIL               // Explicit failure
 } OpCode;
 
+// One bytecode instruction in 8 bytes.  A CHARSET names its class by index
+// into CompiledRegex.charsets, where every distinct class is stored once.
 typedef struct {
-    OpCode op;
+    uint8_t op;                    // OpCode
+    uint8_t negate;                // For OP_CHARSET: 1 if negated [^abc]
+    uint8_t is_end;                // For OP_SAVE_GROUP: 1 at the end of the group
+    char c;                        // For OP_CHAR
     union {
-        char c;                    // For OP_CHAR
         int addr;                  // For jumps/branches
-        struct {                   // For OP_CHARSET
-            uint8_t charset[32];   // 256 bits
-            int negate;
-        };
-        struct {                   // For OP_SAVE_GROUP
-            int group_num;
-            int is_end;
-        };
+        int charset;               // For OP_CHARSET: index into CompiledRegex.charsets
+        int group_num;             // For OP_SAVE_GROUP
     };
 } Instruction;
 
@@ -93,8 +90,12 @@ typedef struct {
     int pc;
     int pos;
     
-    // Integer-only immutable data stack
-    IntStack *data_stack;
+    // Integer data stack: positions from SAVE_POINTER, popped by
+    // RESTORE_POSITION
+    int *data_stack;
+    int data_top;
+    int data_capacity;
+    int data_floor;                  // Entries below this belong to an open choice point
     
     // Capture groups
     int *group_starts;
@@ -105,15 +106,28 @@ typedef struct {
     struct ChoicePoint {
         int pc;
         int pos;
-        IntStack *data_stack;        // Immutable snapshot
-        int *group_starts;
-        int *group_ends;
+        int data_top;                // Data stack height to truncate to
+        int data_floor;              // VM data_floor before this choice point
+        int trail_top;               // Trail height to unwind to
         int flags;
         int last_operation_success;
-        int transferred;             // Flag: 1 if data_stack was transferred back to VM
     } *choice_stack;
     int choice_top;
     int choice_capacity;
+    // Undo log of what was overwritten while a choice point was open:
+    // (slot, old value) pairs, slot >= 0 indexing group_starts then
+    // group_ends, slot < 0 the data stack entry -slot - 1
+    int *trail;
+    int trail_top;
+    int trail_capacity;
+    struct RegexScratch *scratch;    // Owns the stacks and the trail, which grow in it
+    
+    // Explored (CHOICE pc, pos, last_operation_success) states: one flat
+    // bitset, or for texts too long for it, blocks of positions allocated in
+    // the scratch as the search reaches them.  Both NULL runs unmemoized
+    // under the choice and instruction limits.
+    uint8_t *visited;
+    int *visited_blocks;
     
     // Limits
     int choice_count;
@@ -123,19 +137,137 @@ typedef struct {
     int last_operation_success;
 } VM;
 
+// Execution engine used for a CompiledRegex
+typedef enum {
+    REGEX_ENGINE_BACKTRACK,  // Backtracking VM (default)
+    REGEX_ENGINE_PIKE        // Pike VM: linear time, no match limits
+} RegexEngine;
+
+// Default memory cap for the lazy DFA state cache, in bytes
+#define REGEX_DFA_CACHE_LIMIT (1 << 20)
+
+// Most memory the backtracker's visited states take, in bytes: up to this
+// the bitset is flat; longer texts allocate blocks of it as the search
+// reaches them, and a search whose blocks would pass it reruns on the Pike
+// VM, which follows the same states and gives the same answer
+#define REGEX_BACKTRACK_VISITED_LIMIT (256 * 1024)
+
+// Default state limit for compile_regex_dfa
+#define REGEX_FULL_DFA_MAX_STATES 256
+
+struct LazyDFA;
+struct BitNFA;
+struct OnePass;
+struct RegexJit;
+struct ThreadedCode;
+struct LiteralPrefix;
+struct AhoCorasick;
+struct Substring;
+struct RegexScratch;
+
+// Minimized DFA built ahead of time by compile_regex_dfa
+typedef struct FullDFA {
+    int state_count;
+    int *table;              // state_count * 256 transitions
+    uint8_t *eof_match;      // Per state: a match ends at the end of the text
+    int start[4];            // Start state per class of the byte before start_pos
+    int match_state;         // Absorbing state entered when a match is found
+    int dead_state;          // State that can never reach a match, or -1
+    int uses_context;        // Start state depends on the byte before start_pos
+} FullDFA;
+
+// Matching strategies the planner routes calls to
+typedef enum {
+    REGEX_MATCHER_NONE,
+    REGEX_MATCHER_BACKTRACK,  // Backtracking VM with memoization
+    REGEX_MATCHER_PIKE,       // Pike VM
+    REGEX_MATCHER_ONEPASS,    // One-pass capture tables
+    REGEX_MATCHER_JIT,        // Native code from regex_jit_compile
+    REGEX_MATCHER_LAZY_DFA,   // On-demand DFA, VM fallback when its cache overflows
+    REGEX_MATCHER_BITNFA,     // Bit-parallel Glushkov automaton
+    REGEX_MATCHER_FULL_DFA,   // Table from compile_regex_dfa
+    REGEX_MATCHER_SPAN_DFA,   // Forward and reverse DFA scans alone
+    REGEX_MATCHER_REVERSE_DFA,  // Reverse DFA scan back from the end of the text
+    REGEX_MATCHER_AHO_CORASICK, // Literal alternation automaton
+    REGEX_MATCHER_SUBSTRING     // String search for a pattern that is one literal
+} RegexMatcher;
+
+// How a pattern is matched, decided at compile time; see print_regex_plan
 typedef struct {
+    // Pattern analysis
+    int anchored_start;       // Every match begins at ^
+    int anchored_end;         // Every match ends at $
+    int literal_length;       // Pattern is a plain string of this many bytes, otherwise 0
+    char suffix[16];          // Literal every match ends with (lower case under i)...
+    int suffix_length;        // ...and its length, 0 if none
+    int capture_count;        // Capturing groups, not counting the whole match
+    int backtrack_sensitive;  // Loops over alternatives, nested or nullable loops
+
+    // Routing
+    RegexMatcher test;        // execute_regex / regex_test
+    RegexMatcher exec;        // Capture engine for execute_regex_detailed / regex_exec
+    int find_span;            // Locate the match with the DFAs before running exec
+    int span_only;            // ...and the span is the whole answer: exec is not needed
+    int from_end;             // Every match ends at the end of the text: scan back from there
+    int visited_blocks;       // The backtracker keeps its visited set in blocks at any text length
+} RegexPlan;
+
+typedef struct CompiledRegex {
     Instruction *code;
     int code_len;
     int code_capacity;
+    uint8_t (*charsets)[32];  // Distinct CHARSET bitmaps (both cases of each letter under i)
+    int charset_count;
+    int charset_capacity;
     int group_count;
     int flags;
+    RegexEngine engine;
+    struct LazyDFA *dfa;      // State cache for yes/no matching, built on demand
+    int dfa_cache_limit;      // Flush the cache when it grows past this many bytes
+    FullDFA *full_dfa;        // Minimized table from compile_regex_dfa, or NULL
+    struct BitNFA *bitnfa;    // Bit-parallel automaton for patterns of <= 64 positions, or NULL
+    struct OnePass *onepass;  // Backtrack-free capture tables for one-pass programs, or NULL
+    struct RegexJit *jit;     // Native code from regex_jit_compile, or NULL
+    struct ThreadedCode *threaded;  // Handler table for the threaded backtracker, or NULL
+    struct CompiledRegex *reverse;  // Capture-free program matching right to left, built on first use
+    char *source;                   // The pattern, for building reverse; NULL if compile_ast built it
+    struct LazyDFA *span_dfa;       // Leftmost-first state cache for finding match ends, built on demand
+    struct LiteralPrefix *prefix;   // Literals every match starts with, or NULL
+    struct AhoCorasick *aho;        // Automaton for alternations of plain literals, or NULL
+    struct Substring *substring;    // Searcher for a pattern that is a single literal, or NULL
+    int min_length;                 // Fewest bytes a match can span
+    int max_length;                 // Most bytes a match can span, or -1 if unbounded
+    struct RegexScratch *scratch;   // Working memory for calls made without one, made on first use
+    RegexMatcher pinned;            // Capture engine set by regex_pin_matcher, or REGEX_MATCHER_NONE
+    RegexPlan plan;
 } CompiledRegex;
 
 // Low-level VM API
 CompiledRegex* compile_regex(const char *pattern, int flags);
+CompiledRegex* compile_regex_dfa(const char *pattern, int flags, int max_states);
+int regex_jit_compile(CompiledRegex *compiled);
+int regex_leftmost_longest(CompiledRegex *compiled, int longest);
+int regex_pin_matcher(CompiledRegex *compiled, RegexMatcher matcher);
 int execute_regex(CompiledRegex *compiled, const char *text, int start_pos);
 void free_regex(CompiledRegex *compiled);
 void print_regex_bytecode(CompiledRegex *compiled);
+void print_regex_plan(const CompiledRegex *compiled);
+
+// Working memory for the capture engines: choice points, capture arrays,
+// the backtracking bitset, Pike thread lists.  Calls without one use a
+// scratch kept on the CompiledRegex.  A caller that keeps its own (one per
+// thread, say) and passes it in allocates nothing once the buffers have
+// grown to its texts.  One scratch serves any pattern, one search at a time.
+typedef struct RegexScratch RegexScratch;
+RegexScratch* regex_scratch_new(CompiledRegex *compiled);
+void regex_scratch_free(RegexScratch *scratch);
+
+// What the latest execute_regex_scratch and execute_regex_detailed calls on
+// scratch ran after per-call fallbacks, REGEX_MATCHER_NONE when the text was
+// ruled out first.  regex_test and regex_exec record in compiled->scratch.
+RegexMatcher regex_scratch_last_test(const RegexScratch *scratch);
+RegexMatcher regex_scratch_last_exec(const RegexScratch *scratch);
+int execute_regex_scratch(CompiledRegex *compiled, const char *text, int start_pos, RegexScratch *scratch);
 
 // High-level compatibility API for main.c
 typedef struct {
@@ -159,18 +291,52 @@ typedef struct {
     int done;
 } MatchIterator;
 
+// A group's offsets into the searched text, [start, end), or -1 and -1 if
+// the group took no part in the match
+typedef struct {
+    int start;
+    int end;
+} MatchSpan;
+
+// A match as offsets into the caller's text, which is not copied and must
+// outlive it.  match_spans_group makes a group's string on request.
+typedef struct {
+    const char *text;
+    int group_count;
+    MatchSpan *spans;      // spans[0] is the whole match
+} MatchSpans;
+
+typedef struct {
+    RegExp *regexp;
+    const char *text;      // The caller's text, not copied
+    int text_len;
+    int pos;
+    int done;
+    MatchSpans match;      // Returned by every step, overwritten by the next
+} MatchSpanIterator;
+
 // Main API functions expected by main.c
 RegExp* regex_new(const char *pattern, const char *flags);
 int regex_test(RegExp *regexp, const char *text);
 MatchResult* regex_exec(RegExp *regexp, const char *text);
+int regex_test_scratch(RegExp *regexp, const char *text, RegexScratch *scratch);
+MatchResult* regex_exec_scratch(RegExp *regexp, const char *text, RegexScratch *scratch);
 void regex_free(RegExp *regexp);
 void match_result_free(MatchResult *result);
 
+// Span results: no copy of the text, group strings only when asked for
+MatchSpans* regex_exec_spans(RegExp *regexp, const char *text, RegexScratch *scratch);
+char* match_spans_group(const MatchSpans *match, int group);
+void match_spans_free(MatchSpans *match);
+
 // String methods (JavaScript-like API)
 MatchResult* string_match(const char *text, RegExp *regexp);
 MatchIterator* string_match_all(const char *text, RegExp *regexp);
 MatchResult* match_iterator_next(MatchIterator *iter);
 void match_iterator_free(MatchIterator *iter);
+MatchSpanIterator* string_match_all_spans(const char *text, RegExp *regexp);
+const MatchSpans* match_span_iterator_next(MatchSpanIterator *iter);
+void match_span_iterator_free(MatchSpanIterator *iter);
 
 // AST parsing functions (old parse_pattern removed - using lexer+parser)
 ASTNode* create_ast_node(ASTNodeType type);
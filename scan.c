@@ -0,0 +1,114 @@
+// ================================================================
+// BYTE SCAN - Find the next byte of a 256-bit set, 16 or 32 at a time
+// ================================================================
+// This file is amalgamated into regex.c - do not compile separately
+//
+// A set is split by nibbles: low[n] has bit h set when byte h*16+n (h < 8)
+// is in the set, high[n] the same for h >= 8.  pshufb looks up each text
+// byte's row by its low nibble (an index with the top bit set reads 0, which
+// selects low or high), a second pshufb turns its high nibble into the bit
+// to test, and movemask gives the first hit.  AVX2 does 32 bytes per step,
+// SSSE3 16; the choice is made once from cpuid (scan_cpu_level), and
+// everything else (and builds with REGEX_NO_SIMD) uses the scalar loop.
+
+typedef struct {
+    uint8_t set[32];
+    uint8_t low[16];
+    uint8_t high[16];
+} ByteScanner;
+
+static void byte_scanner_init(ByteScanner *scanner, const uint8_t *set) {
+    memcpy(scanner->set, set, 32);
+    memset(scanner->low, 0, 16);
+    memset(scanner->high, 0, 16);
+    for (int c = 0; c < 256; c++) {
+        if (!(set[c >> 3] & (1 << (c & 7)))) continue;
+        if (c < 128) scanner->low[c & 15] |= 1 << (c >> 4);
+        else scanner->high[c & 15] |= 1 << ((c >> 4) - 8);
+    }
+}
+
+// First position >= pos holding a byte of the set, or -1
+static int byte_scan_scalar(const ByteScanner *scanner, const char *text, int text_len, int pos) {
+    for (; pos < text_len; pos++) {
+        unsigned char c = (unsigned char)text[pos];
+        if (scanner->set[c >> 3] & (1 << (c & 7))) return pos;
+    }
+    return -1;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(REGEX_NO_SIMD)
+#include <immintrin.h>
+
+__attribute__((target("ssse3")))
+static int byte_scan_ssse3(const ByteScanner *scanner, const char *text, int text_len, int pos) {
+    __m128i low = _mm_loadu_si128((const __m128i *)scanner->low);
+    __m128i high = _mm_loadu_si128((const __m128i *)scanner->high);
+    __m128i bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    __m128i nibble = _mm_set1_epi8(0x0F);
+    __m128i top = _mm_set1_epi8((char)0x80);
+
+    for (; pos + 16 <= text_len; pos += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(text + pos));
+        __m128i row = _mm_or_si128(_mm_shuffle_epi8(low, v), _mm_shuffle_epi8(high, _mm_xor_si128(v, top)));
+        __m128i bit = _mm_shuffle_epi8(bits, _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(row, bit), bit));
+        if (mask) return pos + __builtin_ctz(mask);
+    }
+    return byte_scan_scalar(scanner, text, text_len, pos);
+}
+
+__attribute__((target("avx2")))
+static int byte_scan_avx2(const ByteScanner *scanner, const char *text, int text_len, int pos) {
+    __m256i low = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)scanner->low));
+    __m256i high = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)scanner->high));
+    __m256i bits = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+                                    1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    __m256i nibble = _mm256_set1_epi8(0x0F);
+    __m256i top = _mm256_set1_epi8((char)0x80);
+
+    for (; pos + 32 <= text_len; pos += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(text + pos));
+        __m256i row = _mm256_or_si256(_mm256_shuffle_epi8(low, v),
+                                      _mm256_shuffle_epi8(high, _mm256_xor_si256(v, top)));
+        __m256i bit = _mm256_shuffle_epi8(bits, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(row, bit), bit));
+        if (mask) return pos + __builtin_ctz(mask);
+    }
+    return byte_scan_ssse3(scanner, text, text_len, pos);
+}
+
+#define SCAN_SCALAR 0
+#define SCAN_SSSE3 1
+#define SCAN_AVX2 2
+
+// Widest vector unit this CPU has; also used by teddy.c
+static int scan_cpu_level(void) {
+    // Every thread computes the same value, so the race is harmless
+    static int level = -1;
+    if (level < 0) {
+        __builtin_cpu_init();
+        level = __builtin_cpu_supports("avx2") ? SCAN_AVX2 :
+                __builtin_cpu_supports("ssse3") ? SCAN_SSSE3 : SCAN_SCALAR;
+    }
+    return level;
+}
+
+static int byte_scan(const ByteScanner *scanner, const char *text, int text_len, int pos) {
+    switch (scan_cpu_level()) {
+        case SCAN_AVX2: return byte_scan_avx2(scanner, text, text_len, pos);
+        case SCAN_SSSE3: return byte_scan_ssse3(scanner, text, text_len, pos);
+        default: return byte_scan_scalar(scanner, text, text_len, pos);
+    }
+}
+#else
+#define SCAN_SCALAR 0
+
+static int scan_cpu_level(void) {
+    return SCAN_SCALAR;
+}
+
+static int byte_scan(const ByteScanner *scanner, const char *text, int text_len, int pos) {
+    return byte_scan_scalar(scanner, text, text_len, pos);
+}
+#endif
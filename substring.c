@@ -0,0 +1,188 @@
+// ================================================================
+// SUBSTRING - Plain string search for patterns that are one literal
+// ================================================================
+// This file is amalgamated into regex.c - do not compile separately
+//
+// A pattern like "connection reset" needs no VM: its matches are exactly
+// the occurrences of the string.  The two rarest bytes of the needle (by
+// prefix_byte_rank) are compared against 32 (AVX2) or 16 (SSE2) candidate
+// starts at once, and the few candidates whose bytes agree at both offsets
+// are compared in full.  Under i a letter is compared with its 0x20 bit
+// forced on, which lets both cases through the filter; the full compare
+// then folds ASCII letters the way the VMs do.  prefix.c uses the same
+// searcher for the literal an i pattern starts with.
+
+typedef struct Substring {
+    int length;
+    int fold;              // i flag: ASCII letters match either case
+    int rare[2];           // Offsets of the two filter bytes, rare[0] <= rare[1]
+    uint8_t value[2];      // Filter bytes, lower case under fold
+    uint8_t mask[2];       // 0x20 for letters under fold, else 0
+    char needle[];         // Lower case under fold
+} Substring;
+
+// An empty searcher for a needle of length >= 1 bytes, or NULL
+static Substring* substring_alloc(int length, int fold) {
+    if (length <= 0) return NULL;
+    Substring *sub = malloc(sizeof(Substring) + (size_t)length);
+    if (!sub) return NULL;
+    sub->length = length;
+    sub->fold = fold;
+    return sub;
+}
+
+// Store needle byte i, lower case under fold
+static void substring_set(Substring *sub, int i, char c) {
+    sub->needle[i] = sub->fold ? (char)ascii_fold((unsigned char)c) : c;
+}
+
+// Pick the filter bytes once the needle is in place
+static Substring* substring_finish(Substring *sub) {
+    int length = sub->length;
+
+    // Rarest byte first, then the rarest at another offset
+    int first = 0, second = -1;
+    for (int i = 1; i < length; i++) {
+        if (prefix_byte_rank(sub->needle[i]) < prefix_byte_rank(sub->needle[first])) first = i;
+    }
+    for (int i = 0; i < length; i++) {
+        if (i == first) continue;
+        if (second < 0 || prefix_byte_rank(sub->needle[i]) < prefix_byte_rank(sub->needle[second])) second = i;
+    }
+    if (second < 0) second = first;
+    sub->rare[0] = first < second ? first : second;
+    sub->rare[1] = first < second ? second : first;
+    for (int k = 0; k < 2; k++) {
+        unsigned char c = sub->needle[sub->rare[k]];
+        sub->value[k] = c;
+        sub->mask[k] = sub->fold && c >= 'a' && c <= 'z' ? 0x20 : 0;
+    }
+    return sub;
+}
+
+// Searcher for length bytes of literal, matched with ASCII case folding
+// if fold is set
+static Substring* substring_new(const char *literal, int length, int fold) {
+    Substring *sub = substring_alloc(length, fold);
+    if (!sub) return NULL;
+    for (int i = 0; i < length; i++) substring_set(sub, i, literal[i]);
+    return substring_finish(sub);
+}
+
+// NULL unless the whole pattern is a string of literal characters
+static Substring* substring_build(ASTNode *ast, int flags) {
+    if (!ast) return NULL;
+    ASTNode **chars = &ast;
+    int length = 1;
+    if (ast->type == AST_SEQUENCE) {
+        chars = ast->data.sequence.children;
+        length = ast->data.sequence.child_count;
+    }
+    for (int i = 0; i < length; i++) {
+        if (chars[i]->type != AST_CHAR) return NULL;
+    }
+
+    // The needle is built in place, straight from the AST
+    Substring *sub = substring_alloc(length, (flags & 2) != 0);
+    if (!sub) return NULL;
+    for (int i = 0; i < length; i++) substring_set(sub, i, chars[i]->data.character);
+    return substring_finish(sub);
+}
+
+static int substring_matches_at(const Substring *sub, const char *text, int pos) {
+    if (!sub->fold) return memcmp(text + pos, sub->needle, sub->length) == 0;
+    for (int i = 0; i < sub->length; i++) {
+        if (ascii_fold((unsigned char)text[pos + i]) != (unsigned char)sub->needle[i]) return 0;
+    }
+    return 1;
+}
+
+// First occurrence at or after pos, or -1
+static int substring_find_scalar(const Substring *sub, const char *text, int text_len, int pos) {
+    for (; pos + sub->length <= text_len; pos++) {
+        if (((unsigned char)text[pos + sub->rare[0]] | sub->mask[0]) != sub->value[0]) continue;
+        if (((unsigned char)text[pos + sub->rare[1]] | sub->mask[1]) != sub->value[1]) continue;
+        if (substring_matches_at(sub, text, pos)) return pos;
+    }
+    return -1;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(REGEX_NO_SIMD)
+// First block of 16 starts in [pos, last] with a candidate, its candidate
+// bits in *mask; past last if none.  A leaf, so the constants stay in
+// registers.
+static int substring_block_sse2(const Substring *sub, const char *text, int pos, int last, unsigned *mask) {
+    __m128i first_mask = _mm_set1_epi8((char)sub->mask[0]), first = _mm_set1_epi8((char)sub->value[0]);
+    __m128i second_mask = _mm_set1_epi8((char)sub->mask[1]), second = _mm_set1_epi8((char)sub->value[1]);
+    const char *first_bytes = text + sub->rare[0], *second_bytes = text + sub->rare[1];
+
+    for (; pos <= last; pos += 16) {
+        __m128i a = _mm_or_si128(_mm_loadu_si128((const __m128i *)(first_bytes + pos)), first_mask);
+        __m128i b = _mm_or_si128(_mm_loadu_si128((const __m128i *)(second_bytes + pos)), second_mask);
+        *mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, second)));
+        if (*mask) return pos;
+    }
+    return pos;
+}
+
+__attribute__((target("avx2")))
+static int substring_block_avx2(const Substring *sub, const char *text, int pos, int last, unsigned *mask) {
+    __m256i first_mask = _mm256_set1_epi8((char)sub->mask[0]), first = _mm256_set1_epi8((char)sub->value[0]);
+    __m256i second_mask = _mm256_set1_epi8((char)sub->mask[1]), second = _mm256_set1_epi8((char)sub->value[1]);
+    const char *first_bytes = text + sub->rare[0], *second_bytes = text + sub->rare[1];
+
+    // Two blocks per step while both fit, then one
+    for (; pos + 32 <= last; pos += 64) {
+        __m256i a = _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(first_bytes + pos)), first_mask);
+        __m256i b = _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(second_bytes + pos)), second_mask);
+        __m256i c = _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(first_bytes + pos + 32)), first_mask);
+        __m256i d = _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(second_bytes + pos + 32)), second_mask);
+        __m256i low = _mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, second));
+        __m256i high = _mm256_and_si256(_mm256_cmpeq_epi8(c, first), _mm256_cmpeq_epi8(d, second));
+        if (_mm256_testz_si256(_mm256_or_si256(low, high), _mm256_or_si256(low, high))) continue;
+        *mask = (unsigned)_mm256_movemask_epi8(low);
+        if (*mask) return pos;
+        *mask = (unsigned)_mm256_movemask_epi8(high);
+        return pos + 32;
+    }
+    for (; pos <= last; pos += 32) {
+        __m256i a = _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(first_bytes + pos)), first_mask);
+        __m256i b = _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(second_bytes + pos)), second_mask);
+        *mask = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first),
+                                                                _mm256_cmpeq_epi8(b, second)));
+        if (*mask) return pos;
+    }
+    return pos;
+}
+
+// Candidate blocks of width bytes from the scanner for the CPU, each
+// candidate confirmed in full; the tail goes through the scalar loop
+static int substring_find_blocks(const Substring *sub, const char *text, int text_len, int pos, int width) {
+    int last = text_len - width - sub->rare[1];
+    while (pos <= last) {
+        unsigned mask;
+        pos = width == 32 ? substring_block_avx2(sub, text, pos, last, &mask)
+                          : substring_block_sse2(sub, text, pos, last, &mask);
+        if (pos > last) break;
+        for (; mask; mask &= mask - 1) {
+            int candidate = pos + __builtin_ctz(mask);
+            if (candidate + sub->length > text_len) return -1;
+            if (substring_matches_at(sub, text, candidate)) return candidate;
+        }
+        pos += width;
+    }
+    return substring_find_scalar(sub, text, text_len, pos);
+}
+
+static int substring_find(const Substring *sub, const char *text, int text_len, int pos) {
+    switch (scan_cpu_level()) {
+        case SCAN_AVX2: return substring_find_blocks(sub, text, text_len, pos, 32);
+        case SCAN_SSSE3: return substring_find_blocks(sub, text, text_len, pos, 16);
+        default: return substring_find_scalar(sub, text, text_len, pos);
+    }
+}
+#else
+static int substring_find(const Substring *sub, const char *text, int text_len, int pos) {
+    return substring_find_scalar(sub, text, text_len, pos);
+}
+#endif
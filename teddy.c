@@ -0,0 +1,139 @@
+// ================================================================
+// TEDDY - Packed search for the start of any of several literals
+// ================================================================
+// This file is amalgamated into regex.c - do not compile separately
+//
+// timeout|refused|reset by peer|OOM: the literals are grouped into 8
+// buckets and the first 1-3 bytes of each are fingerprinted into nibble
+// tables, low[k][n] / high[k][n] holding the buckets whose byte k has low /
+// high nibble n.  For 16 or 32 start positions at once, pshufb looks up
+// both nibbles of each fingerprint byte and the results are ANDed; a
+// nonzero lane is a candidate start together with the buckets it may
+// begin, whose literals the caller confirms with memcmp.  Literals sharing
+// their fingerprint share a bucket, so with up to 8 distinct fingerprints
+// a candidate fails only on the bytes after them.
+
+#define TEDDY_BUCKETS 8
+#define TEDDY_MAX_FINGERPRINT 3
+
+typedef struct {
+    int length;                                 // Fingerprinted bytes, 1 to 3
+    uint8_t low[TEDDY_MAX_FINGERPRINT][16];
+    uint8_t high[TEDDY_MAX_FINGERPRINT][16];
+    uint64_t members[TEDDY_BUCKETS];            // Literal indexes in each bucket
+} Teddy;
+
+// Literal i starts at literals + i * stride and has lengths[i] >= 1 bytes;
+// count <= 64.  With fold set the literals are lower case, and a letter
+// is fingerprinted in both cases, so the scan needs no folding of its own.
+static void teddy_init(Teddy *teddy, const char *literals, int stride, const int *lengths, int count, int fold) {
+    memset(teddy, 0, sizeof(Teddy));
+    teddy->length = TEDDY_MAX_FINGERPRINT;
+    for (int i = 0; i < count; i++) {
+        if (lengths[i] < teddy->length) teddy->length = lengths[i];
+    }
+
+    int bucket_of[64];
+    int buckets_used = 0;
+    for (int i = 0; i < count; i++) {
+        bucket_of[i] = -1;
+        for (int j = 0; j < i; j++) {
+            if (memcmp(literals + i * stride, literals + j * stride, teddy->length) == 0) {
+                bucket_of[i] = bucket_of[j];
+                break;
+            }
+        }
+        if (bucket_of[i] < 0) bucket_of[i] = buckets_used++ % TEDDY_BUCKETS;
+
+        teddy->members[bucket_of[i]] |= 1ULL << i;
+        for (int k = 0; k < teddy->length; k++) {
+            unsigned char c = (unsigned char)literals[i * stride + k];
+            teddy->low[k][c & 15] |= 1 << bucket_of[i];
+            teddy->high[k][c >> 4] |= 1 << bucket_of[i];
+            if (fold && c >= 'a' && c <= 'z') teddy->high[k][(c - 32) >> 4] |= 1 << bucket_of[i];
+        }
+    }
+}
+
+// First candidate start in [pos, end - length], with its buckets, or -1
+static int teddy_find_scalar(const Teddy *teddy, const char *text, int end, int pos, int *buckets) {
+    for (; pos + teddy->length <= end; pos++) {
+        int mask = 0xFF;
+        for (int k = 0; k < teddy->length; k++) {
+            unsigned char c = (unsigned char)text[pos + k];
+            mask &= teddy->low[k][c & 15] & teddy->high[k][c >> 4];
+        }
+        if (mask) {
+            *buckets = mask;
+            return pos;
+        }
+    }
+    return -1;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(REGEX_NO_SIMD)
+__attribute__((target("ssse3")))
+static int teddy_find_ssse3(const Teddy *teddy, const char *text, int end, int pos, int *buckets) {
+    __m128i nibble = _mm_set1_epi8(0x0F);
+    __m128i zero = _mm_setzero_si128();
+
+    for (; pos + 16 + teddy->length - 1 <= end; pos += 16) {
+        __m128i candidates = _mm_set1_epi8((char)0xFF);
+        for (int k = 0; k < teddy->length; k++) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(text + pos + k));
+            __m128i low = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)teddy->low[k]), _mm_and_si128(v, nibble));
+            __m128i high = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)teddy->high[k]),
+                                            _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+            candidates = _mm_and_si128(candidates, _mm_and_si128(low, high));
+        }
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(candidates, zero)) ^ 0xFFFF;
+        if (mask) {
+            uint8_t lanes[16];
+            _mm_storeu_si128((__m128i *)lanes, candidates);
+            int lane = __builtin_ctz(mask);
+            *buckets = lanes[lane];
+            return pos + lane;
+        }
+    }
+    return teddy_find_scalar(teddy, text, end, pos, buckets);
+}
+
+__attribute__((target("avx2")))
+static int teddy_find_avx2(const Teddy *teddy, const char *text, int end, int pos, int *buckets) {
+    __m256i nibble = _mm256_set1_epi8(0x0F);
+    __m256i zero = _mm256_setzero_si256();
+
+    for (; pos + 32 + teddy->length - 1 <= end; pos += 32) {
+        __m256i candidates = _mm256_set1_epi8((char)0xFF);
+        for (int k = 0; k < teddy->length; k++) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(text + pos + k));
+            __m256i low_table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)teddy->low[k]));
+            __m256i high_table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)teddy->high[k]));
+            __m256i low = _mm256_shuffle_epi8(low_table, _mm256_and_si256(v, nibble));
+            __m256i high = _mm256_shuffle_epi8(high_table, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+            candidates = _mm256_and_si256(candidates, _mm256_and_si256(low, high));
+        }
+        unsigned mask = ~(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(candidates, zero));
+        if (mask) {
+            uint8_t lanes[32];
+            _mm256_storeu_si256((__m256i *)lanes, candidates);
+            int lane = __builtin_ctz(mask);
+            *buckets = lanes[lane];
+            return pos + lane;
+        }
+    }
+    return teddy_find_ssse3(teddy, text, end, pos, buckets);
+}
+
+static int teddy_find(const Teddy *teddy, const char *text, int end, int pos, int *buckets) {
+    switch (scan_cpu_level()) {
+        case SCAN_AVX2: return teddy_find_avx2(teddy, text, end, pos, buckets);
+        case SCAN_SSSE3: return teddy_find_ssse3(teddy, text, end, pos, buckets);
+        default: return teddy_find_scalar(teddy, text, end, pos, buckets);
+    }
+}
+#else
+static int teddy_find(const Teddy *teddy, const char *text, int end, int pos, int *buckets) {
+    return teddy_find_scalar(teddy, text, end, pos, buckets);
+}
+#endif
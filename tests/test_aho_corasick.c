@@ -0,0 +1,92 @@
+#include "test_shared.h"
+
+void test_aho_corasick_eligibility(void) {
+    const char *eligible[] = {"cat|dog|bird", "(GET|POST|PUT)", "a|b", "\\.com|\\.org|-x"};
+    const char *ineligible[] = {"cat|do?g", "(cat)|dog", "catdog", "^cat|dog", "cat|[dh]og"};
+
+    for (int i = 0; i < (int)(sizeof(eligible) / sizeof(eligible[0])); i++) {
+        RegExp *re = regex_new(eligible[i], "");
+        TEST_ASSERT_NOT_NULL_MESSAGE(re->compiled->aho, eligible[i]);
+        TEST_ASSERT_EQUAL_INT(REGEX_MATCHER_AHO_CORASICK, re->compiled->plan.exec);
+        regex_free(re);
+    }
+
+    for (int i = 0; i < (int)(sizeof(ineligible) / sizeof(ineligible[0])); i++) {
+        RegExp *re = regex_new(ineligible[i], "");
+        TEST_ASSERT_NULL_MESSAGE(re->compiled->aho, ineligible[i]);
+        regex_free(re);
+    }
+}
+
+void test_aho_corasick_leftmost_first(void) {
+    // The leftmost start wins, then the first alternative, as in the VMs
+    ASSERT_GROUP_MATCH("sam|samwise", "samwise", 0, "sam");
+    ASSERT_GROUP_MATCH("samwise|sam", "samwise", 0, "samwise");
+    ASSERT_GROUP_MATCH("bc|abcd", "xabcd", 0, "abcd");
+    ASSERT_GROUP_MATCH("bcd|abcdef", "abcdex", 0, "bcd");
+    ASSERT_GROUP_MATCH("(GET|POST)", "x POST /", 1, "POST");
+
+    RegExp *re = regex_new("get|Post|HEAD", "i");
+    MatchResult *result = regex_exec(re, "a pOST b");
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL_INT(2, result->index);
+    TEST_ASSERT_EQUAL_STRING("pOST", result->groups[0]);
+    match_result_free(result);
+    TEST_ASSERT_FALSE(regex_test(re, "PUT Posh"));
+    regex_free(re);
+}
+
+void test_aho_corasick_leftmost_longest(void) {
+    RegExp *re = regex_new("sam|samwise|wise", "g");
+    TEST_ASSERT_TRUE(regex_leftmost_longest(re->compiled, 1));
+
+    MatchIterator *iter = string_match_all("samwise sam wisest", re);
+    const char *expected[] = {"samwise", "sam", "wise"};
+    int indexes[] = {0, 8, 12};
+    for (int i = 0; i < 3; i++) {
+        MatchResult *result = match_iterator_next(iter);
+        TEST_ASSERT_NOT_NULL(result);
+        TEST_ASSERT_EQUAL_INT(indexes[i], result->index);
+        TEST_ASSERT_EQUAL_STRING(expected[i], result->groups[0]);
+        match_result_free(result);
+    }
+    TEST_ASSERT_NULL(match_iterator_next(iter));
+    match_iterator_free(iter);
+    regex_free(re);
+
+    // Only literal alternations have the choice
+    re = regex_new("sam(wise)?", "");
+    TEST_ASSERT_FALSE(regex_leftmost_longest(re->compiled, 1));
+    regex_free(re);
+}
+
+void test_aho_corasick_keyword_list(void) {
+    // 2000 keywords, far more than the prefix set holds
+    int count = 2000;
+    char *pattern = malloc(count * 9 + 1);
+    int length = 0;
+    for (int i = 0; i < count; i++) {
+        length += sprintf(pattern + length, "%skw%04d", i ? "|" : "", i * 7);
+    }
+
+    RegExp *re = regex_new(pattern, "gi");
+    TEST_ASSERT_NOT_NULL(re->compiled->aho);
+
+    const char *text = "kw0006 KW0007 xkw13986kw0014 kw1 kw00";
+    MatchIterator *iter = string_match_all(text, re);
+    const char *expected[] = {"KW0007", "kw13986", "kw0014"};
+    int indexes[] = {7, 15, 22};
+    for (int i = 0; i < 3; i++) {
+        MatchResult *result = match_iterator_next(iter);
+        TEST_ASSERT_NOT_NULL(result);
+        TEST_ASSERT_EQUAL_INT(indexes[i], result->index);
+        TEST_ASSERT_EQUAL_STRING(expected[i], result->groups[0]);
+        match_result_free(result);
+    }
+    TEST_ASSERT_NULL(match_iterator_next(iter));
+    match_iterator_free(iter);
+
+    TEST_ASSERT_FALSE(regex_test(re, "kw0006 kw0013 kw"));
+    regex_free(re);
+    free(pattern);
+}
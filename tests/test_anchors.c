@@ -18,4 +18,81 @@ void test_end_anchor(void) {
 void test_multiline_anchors(void) {
     ASSERT_MATCH_WITH_FLAGS("^world", "m", "hello\nworld");
     ASSERT_MATCH_WITH_FLAGS("hello$", "m", "hello\nworld");
+}
+
+void test_anchored_start_positions(void) {
+    // Without m, ^ allows one start: the attempt at offset 0
+    RegExp *re = regex_new("^\\w+\\d$", "g");
+    TEST_ASSERT_NOT_NULL(re->compiled->prefix);
+    char text[4001];
+    memset(text, 'a', sizeof(text) - 1);
+    text[sizeof(text) - 1] = '\0';
+    TEST_ASSERT_FALSE(regex_test(re, text));
+    text[sizeof(text) - 2] = '7';
+    TEST_ASSERT_TRUE(regex_test(re, text));
+    assert_exec_each_engine(re, text, 0, NULL);
+    // last_index is past 0, so nothing is left
+    assert_exec_each_engine(re, text, -1, NULL);
+    regex_free(re);
+
+    // Under m the starts are the line starts, including an empty last line
+    const char *patterns[] = {"^\\d+", "^(\\w*)$", "^$"};
+    const char *texts[] = {"x12\nab\n34\nx5\n6", "x!\n-\n", "a\n\nb\n"};
+    const char *expected[] = {"34", "", ""};
+    int indexes[] = {7, 5, 2};
+
+    for (int i = 0; i < 3; i++) {
+        re = regex_new(patterns[i], "m");
+        TEST_ASSERT_TRUE(regex_test(re, texts[i]));
+        assert_exec_each_engine(re, texts[i], indexes[i], expected[i]);
+        regex_free(re);
+    }
+}
+
+void test_match_from_end(void) {
+    // Matches of a pattern ending at $ end at the end of the text: the
+    // literal suffix is compared there, then the scan reads back
+    RegExp *re = regex_new("(\\w+)\\.(jpg|png)$", "i");
+    RegexPlan *plan = &re->compiled->plan;
+    TEST_ASSERT_TRUE(plan->from_end);
+    TEST_ASSERT_EQUAL_INT(REGEX_MATCHER_REVERSE_DFA, plan->test);
+    TEST_ASSERT_EQUAL_INT(1, plan->suffix_length);
+    TEST_ASSERT_EQUAL_STRING_LEN("g", plan->suffix, 1);
+
+    TEST_ASSERT_FALSE(regex_test(re, "cat.jpg dog.gif"));
+    TEST_ASSERT_EQUAL_INT(REGEX_MATCHER_NONE, regex_scratch_last_test(re->compiled->scratch));
+    TEST_ASSERT_FALSE(regex_test(re, "cat.jpg dog.jpeg"));
+    MatchResult *result = regex_exec(re, "cat.jpg and dog.PNG");
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL_INT(12, result->index);
+    TEST_ASSERT_EQUAL_STRING("dog", result->groups[1]);
+    TEST_ASSERT_EQUAL_STRING("PNG", result->groups[2]);
+    match_result_free(result);
+    regex_free(re);
+
+    const char *patterns[] = {"\\d+$", "a*$", "\\bx\\w*y$", "^ab(c|bc)$", "(foo|barfoo)$"};
+    const char *texts[] = {"12 ab 345", "baa", "axy xy", "abbc", "foobarfoo"};
+    int indexes[] = {6, 1, 4, 0, 3};
+    const char *suffixes[] = {"", "", "y", "c", "foo"};
+
+    for (int i = 0; i < 5; i++) {
+        re = regex_new(patterns[i], "");
+        TEST_ASSERT_TRUE(re->compiled->plan.from_end);
+        TEST_ASSERT_EQUAL_INT((int)strlen(suffixes[i]), re->compiled->plan.suffix_length);
+        TEST_ASSERT_TRUE(regex_test(re, texts[i]));
+        assert_exec_each_engine(re, texts[i], indexes[i], texts[i] + indexes[i]);
+        regex_free(re);
+    }
+
+    // A g search that has moved past the start of the match is over
+    re = regex_new("\\w+$", "g");
+    assert_exec_each_engine(re, "ab cd", 3, "cd");
+    assert_exec_each_engine(re, "ab cd", -1, NULL);
+    regex_free(re);
+
+    // Under m a match can end at any line end
+    re = regex_new("\\d+$", "m");
+    TEST_ASSERT_FALSE(re->compiled->plan.from_end);
+    TEST_ASSERT_TRUE(regex_test(re, "12\nab"));
+    regex_free(re);
 }
\ No newline at end of file
@@ -174,4 +174,129 @@ void test_comprehensive_match_iterator(void) {
         match_iterator_free(iter);
         regex_free(re);
     }
-}
\ No newline at end of file
+}
+// Span results point into the caller's text instead of copying it
+void test_match_spans(void) {
+    const char *text = "key=val; x=; name=bob";
+    RegExp *re = regex_new("(\\w+)=(\\w+)?", "");
+    MatchSpans *match = regex_exec_spans(re, text, NULL);
+
+    TEST_ASSERT_NOT_NULL(match);
+    TEST_ASSERT_TRUE(match->text == text);
+    TEST_ASSERT_EQUAL_INT(3, match->group_count);
+    TEST_ASSERT_EQUAL_INT(0, match->spans[0].start);
+    TEST_ASSERT_EQUAL_INT(7, match->spans[0].end);
+    TEST_ASSERT_EQUAL_INT(4, match->spans[2].start);
+
+    char *value = match_spans_group(match, 2);
+    TEST_ASSERT_EQUAL_STRING("val", value);
+    free(value);
+    TEST_ASSERT_NULL(match_spans_group(match, 3));
+    match_spans_free(match);
+    regex_free(re);
+
+    // The iterator finds what string_match_all finds, reusing one result
+    re = regex_new("(\\w+)=(\\w+)?", "g");
+    MatchSpanIterator *iter = string_match_all_spans(text, re);
+    TEST_ASSERT_NOT_NULL(iter);
+
+    const char *expected[][3] = {{"key=val", "key", "val"}, {"x=", "x", NULL}, {"name=bob", "name", "bob"}};
+    const MatchSpans *step;
+    int count = 0;
+    while ((step = match_span_iterator_next(iter)) != NULL) {
+        TEST_ASSERT_LESS_THAN(3, count);
+        for (int g = 0; g < 3; g++) {
+            char *group = match_spans_group(step, g);
+            if (expected[count][g]) {
+                TEST_ASSERT_EQUAL_STRING(expected[count][g], group);
+            } else {
+                TEST_ASSERT_NULL(group);
+                TEST_ASSERT_EQUAL_INT(-1, step->spans[g].start);
+            }
+            free(group);
+        }
+        count++;
+    }
+    TEST_ASSERT_EQUAL_INT(3, count);
+    TEST_ASSERT_NULL(match_span_iterator_next(iter));
+    match_span_iterator_free(iter);
+
+    // Empty matches are stepped over rather than found again
+    RegExp *empty = regex_new("x*", "g");
+    iter = string_match_all_spans("axxb", empty);
+    int starts[4], n = 0;
+    while ((step = match_span_iterator_next(iter)) != NULL && n < 4) starts[n++] = step->spans[0].start;
+    TEST_ASSERT_EQUAL_INT(3, n);
+    TEST_ASSERT_EQUAL_INT(0, starts[0]);
+    TEST_ASSERT_EQUAL_INT(1, starts[1]);
+    TEST_ASSERT_EQUAL_INT(3, starts[2]);
+    match_span_iterator_free(iter);
+    regex_free(empty);
+
+    regex_free(re);
+
+    // Like string_match_all, only for global patterns
+    re = regex_new("\\w+", "");
+    TEST_ASSERT_NULL(string_match_all_spans(text, re));
+    regex_free(re);
+}
+
+void test_reusable_scratch(void) {
+    // One scratch serves every engine and pattern in turn, growing for the
+    // bigger ones, and answers exactly as the pattern's own scratch does
+    const char *patterns[] = {"(\\w+)@(\\w+)\\.com", "(a|ab)*(c)", "((x)|(y))+z", "(\\d+)-(\\d+)"};
+    char text[5000];
+    for (int i = 0; i < (int)sizeof(text) - 1; i++) text[i] = "ab cxy,"[i % 7];
+    text[sizeof(text) - 1] = '\0';
+    memcpy(text + 3000, "xyyz 12-345 me@host.com", 23);
+
+    RegexScratch *scratch = regex_scratch_new(NULL);
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < 4; i++) {
+            RegExp *re = regex_new(patterns[i], "");
+            // Backtracker on every start position, Pike, then the plan
+            RegexMatcher matchers[] = {REGEX_MATCHER_BACKTRACK, REGEX_MATCHER_PIKE, REGEX_MATCHER_NONE};
+            for (int engine = 0; engine < 3; engine++) {
+                TEST_ASSERT_TRUE(regex_pin_matcher(re->compiled, matchers[engine]));
+                if (matchers[engine] == REGEX_MATCHER_NONE) regex_jit_compile(re->compiled);
+
+                const char *inputs[] = {text, "no match here", patterns[i]};
+                for (int k = 0; k < 3; k++) {
+                    MatchResult *own = regex_exec(re, inputs[k]);
+                    MatchResult *shared = regex_exec_scratch(re, inputs[k], scratch);
+                    TEST_ASSERT_EQUAL_INT(regex_test(re, inputs[k]), regex_test_scratch(re, inputs[k], scratch));
+                    TEST_ASSERT_EQUAL_INT(own != NULL, shared != NULL);
+                    if (own) {
+                        TEST_ASSERT_EQUAL_INT(own->index, shared->index);
+                        TEST_ASSERT_EQUAL_INT(own->group_count, shared->group_count);
+                        for (int g = 0; g < own->group_count; g++) {
+                            if (own->groups[g]) {
+                                TEST_ASSERT_EQUAL_STRING(own->groups[g], shared->groups[g]);
+                            } else {
+                                TEST_ASSERT_NULL(shared->groups[g]);
+                            }
+                        }
+                    }
+                    match_result_free(own);
+                    match_result_free(shared);
+                }
+            }
+            regex_free(re);
+        }
+    }
+    regex_scratch_free(scratch);
+
+    // Sized from a pattern up front, a scratch still grows for a bigger one
+    RegExp *small = regex_new("a", "");
+    RegExp *big = regex_new("(a)(b)(c)(d)(e)(f)(g)(h)", "");
+    scratch = regex_scratch_new(small->compiled);
+    regex_pin_matcher(big->compiled, REGEX_MATCHER_BACKTRACK);
+    MatchResult *result = regex_exec_scratch(big, "xxabcdefgh", scratch);
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL_INT(2, result->index);
+    TEST_ASSERT_EQUAL_STRING("h", result->groups[8]);
+    match_result_free(result);
+    regex_scratch_free(scratch);
+    regex_free(small);
+    regex_free(big);
+}
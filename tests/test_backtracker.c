@@ -0,0 +1,168 @@
+#include "test_shared.h"
+
+// A long text gets the captures a short one does, whether the visited bits
+// fit in blocks or the search ends on the Pike VM
+void test_long_text_matches_short(void) {
+    const char *cases[][2] = {
+        {"(^|\\d|[^a])+z?", ".1A"},
+        {"b|(^|\\d|[^a])+", ".1A"},
+        {"(^)*", "x"},
+        {"((a)|b?)+c", "abac"},
+        {"(a|ab)(c|bcd)(d*)", "abcd"},
+        {"(\\w+)@(\\d*)", "user@"},
+    };
+    int case_count = sizeof(cases) / sizeof(cases[0]);
+
+    // Far more text than one visited bitset covers
+    int padding = 300000;
+    char *long_text = malloc(padding + 16);
+
+    for (int i = 0; i < case_count; i++) {
+        size_t length = strlen(cases[i][1]);
+        memcpy(long_text, cases[i][1], length);
+        memset(long_text + length, 'a', padding);
+        long_text[length + padding] = '\0';
+
+        RegExp *re = regex_new(cases[i][0], "");
+        MatchResult *expected = regex_exec(re, cases[i][1]);
+        MatchResult *actual = regex_exec(re, long_text);
+        TEST_ASSERT_NOT_NULL_MESSAGE(expected, cases[i][0]);
+        TEST_ASSERT_NOT_NULL_MESSAGE(actual, cases[i][0]);
+        TEST_ASSERT_EQUAL_INT(expected->index, actual->index);
+        for (int g = 0; g < expected->group_count; g++) {
+            if (expected->groups[g]) {
+                TEST_ASSERT_EQUAL_STRING_MESSAGE(expected->groups[g], actual->groups[g], cases[i][0]);
+            } else {
+                TEST_ASSERT_NULL_MESSAGE(actual->groups[g], cases[i][0]);
+            }
+        }
+        match_result_free(expected);
+        match_result_free(actual);
+        regex_free(re);
+    }
+
+    // Here the greedy loop runs over the whole text: the blocks outgrow
+    // their limit and the Pike VM finishes the search
+    memset(long_text, 'a', padding);
+    strcpy(long_text + padding, "@b");
+    RegExp *re = regex_new("(\\w+)@(\\w*)", "");
+    MatchResult *result = regex_exec(re, long_text);
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL_INT(0, result->index);
+    TEST_ASSERT_EQUAL_INT(padding, (int)strlen(result->groups[1]));
+    TEST_ASSERT_EQUAL_STRING("b", result->groups[2]);
+    match_result_free(result);
+    regex_free(re);
+
+    free(long_text);
+}
+
+void test_capture_trail(void) {
+    // Captures set on a path that later fails are unwound to what they were
+    // at the choice point, however far back it is
+    const char *patterns[] = {"(a|ab)(c|bcd)(d*)", "((a)|(b))+c", "(x)?(x)?(\\w)*y!", "((\\w)(\\w)?)*z"};
+    const char *texts[] = {"abcd", "abac", "xxaby!", "abcdz"};
+    const char *expected[][4] = {
+        {"abcd", "a", "bcd", ""},
+        {"abac", "a", "a", "b"},
+        {"xxaby!", "x", "x", "b"},
+        {"abcdz", "cd", "c", "d"}
+    };
+
+    for (int i = 0; i < 4; i++) {
+        RegExp *re = regex_new(patterns[i], "");
+        assert_groups_each_engine(re, texts[i], 0, expected[i]);
+        regex_free(re);
+    }
+}
+
+void test_position_stack(void) {
+    // * loops push a position per iteration; nested ones keep many on the
+    // stack at once and drop them again as choice points fail back.  The
+    // results are those of the linked-list stack this one replaced.
+    char words[1001];
+    for (int i = 0; i < 200; i++) memcpy(words + 5 * i, "word ", 5);
+    words[1000] = '\0';
+
+    RegExp *re = regex_new("(\\w+\\s*)*x", "");
+    assert_groups_each_engine(re, words, -1, NULL);
+    assert_groups_each_engine(re, "ab cd x", 0, (const char *[]){"ab cd x", "cd "});
+    assert_groups_each_engine(re, "abx  yx", 0, (const char *[]){"abx  yx", "y"});
+    regex_free(re);
+
+    re = regex_new("((a|ab)*c)+", "");
+    assert_groups_each_engine(re, "abacabcaacx", 0, (const char *[]){"abacabcaac", "aac", "a"});
+    assert_groups_each_engine(re, "aabcabac", 0, (const char *[]){"aabcabac", "abac", "a"});
+    assert_groups_each_engine(re, "cc", 0, (const char *[]){"cc", "c", NULL});
+    assert_groups_each_engine(re, "ababab", -1, NULL);
+    regex_free(re);
+
+    re = regex_new("((\\w+\\s*)*,)*;", "");
+    assert_groups_each_engine(re, "a b,c,;", 0, (const char *[]){"a b,c,;", "c,", "c"});
+    assert_groups_each_engine(re, "x,;;", 0, (const char *[]){"x,;", "x,", "x"});
+    assert_groups_each_engine(re, ";", 0, (const char *[]){";", NULL, NULL});
+    assert_groups_each_engine(re, "a b,c,", -1, NULL);
+    regex_free(re);
+
+    re = regex_new("(a*b*)*c", "");
+    assert_groups_each_engine(re, "ababbac", 0, (const char *[]){"ababbac", "a"});
+    assert_groups_each_engine(re, "c", 0, (const char *[]){"c", ""});
+    assert_groups_each_engine(re, "abab", -1, NULL);
+    regex_free(re);
+}
+
+void test_position_trail(void) {
+    // The compiler never emits RESTORE_POSITION, so this program is built
+    // by hand: it pops below a choice point's floor, pushes over those
+    // entries and fails back, and the alternative must see the old ones.
+    // It needs the switch interpreter, as the threaded one is built from
+    // the original program.
+    RegExp *re = regex_new("a*", "");
+    if (re->compiled->threaded) {
+        regex_free(re);
+        TEST_IGNORE_MESSAGE("needs REGEX_NO_THREADED_DISPATCH");
+    }
+
+    Instruction program[20] = {
+        {.op = OP_SAVE_GROUP, .group_num = 0},
+        {.op = OP_SAVE_POINTER},
+        {.op = OP_CHAR, .c = 'a'},
+        {.op = OP_SAVE_POINTER},
+        {.op = OP_CHAR, .c = 'a'},
+        {.op = OP_CHOICE, .addr = 8},  // Floor above both positions
+        {.op = OP_RESTORE_POSITION},
+        {.op = OP_RESTORE_POSITION},
+        {.op = OP_CHAR, .c = 'a'},
+        {.op = OP_SAVE_POINTER},       // Overwrites the first position
+        {.op = OP_CHAR, .c = 'a'},
+        {.op = OP_SAVE_POINTER},       // ...and the second
+        {.op = OP_CHAR, .c = 'x'},     // Fails back to the CHOICE
+        {.op = OP_RESTORE_POSITION},
+        {.op = OP_RESTORE_POSITION},
+        {.op = OP_CHAR, .c = 'a'},
+        {.op = OP_CHAR, .c = 'a'},
+        {.op = OP_CHAR, .c = 'b'},
+        {.op = OP_SAVE_GROUP, .group_num = 0, .is_end = 1},
+        {.op = OP_MATCH}
+    };
+    free(re->compiled->code);
+    re->compiled->code = malloc(sizeof(program));
+    memcpy(re->compiled->code, program, sizeof(program));
+    re->compiled->code_len = re->compiled->code_capacity = 20;
+    TEST_ASSERT_TRUE(regex_pin_matcher(re->compiled, REGEX_MATCHER_BACKTRACK));
+
+    const char *texts[] = {"aab", "xaab", "aaab", "ab"};
+    int indexes[] = {0, 1, 1, -1};
+    for (int i = 0; i < 4; i++) {
+        MatchResult *result = regex_exec(re, texts[i]);
+        if (indexes[i] < 0) {
+            TEST_ASSERT_NULL(result);
+            continue;
+        }
+        TEST_ASSERT_NOT_NULL_MESSAGE(result, texts[i]);
+        TEST_ASSERT_EQUAL_INT(indexes[i], result->index);
+        TEST_ASSERT_EQUAL_STRING("aab", result->groups[0]);
+        match_result_free(result);
+    }
+    regex_free(re);
+}
@@ -0,0 +1,46 @@
+#include "test_shared.h"
+
+void test_bitnfa_eligibility(void) {
+    const char *eligible[] = {"\\d{3}-\\d{4}", "[A-Z]{2}\\d+", "^(ab|cd)+x$", "colou?r", "a.c", ""};
+    const char *ineligible[] = {"\\bword\\b", "a{65}", "a^b", "(^a|b)"};
+
+    for (int i = 0; i < (int)(sizeof(eligible) / sizeof(eligible[0])); i++) {
+        RegExp *re = regex_new(eligible[i], "");
+        // The empty pattern never reaches the AST, so it has no automaton
+        if (eligible[i][0]) TEST_ASSERT_NOT_NULL_MESSAGE(re->compiled->bitnfa, eligible[i]);
+        regex_free(re);
+    }
+
+    for (int i = 0; i < (int)(sizeof(ineligible) / sizeof(ineligible[0])); i++) {
+        RegExp *re = regex_new(ineligible[i], "");
+        TEST_ASSERT_NULL_MESSAGE(re->compiled->bitnfa, ineligible[i]);
+        regex_free(re);
+    }
+
+    // Line anchors depend on the surrounding text, so multiline mode opts out
+    RegExp *re = regex_new("^abc$", "m");
+    TEST_ASSERT_NULL(re->compiled->bitnfa);
+    regex_free(re);
+}
+
+void test_bitnfa_shift_and_patterns(void) {
+    ASSERT_MATCH("\\d{3}-\\d{4}", "call 555-1234 now");
+    ASSERT_NO_MATCH("\\d{3}-\\d{4}", "call 555-123 now");
+    ASSERT_MATCH("[A-Z]{2}\\d+", "ref AB12");
+    ASSERT_NO_MATCH("[A-Z]{2}\\d+", "ref A12 b34");
+    ASSERT_MATCH_WITH_FLAGS("[a-z]{2}\\d+", "i", "REF AB12");
+    ASSERT_MATCH("^\\d+$", "12345");
+    ASSERT_NO_MATCH("^\\d+$", "123a45");
+}
+
+void test_bitnfa_glushkov_patterns(void) {
+    ASSERT_MATCH("(ab|cd)+x", "zzabcdabx");
+    ASSERT_NO_MATCH("(ab|cd)+x", "zzabcdacx");
+    ASSERT_MATCH("^(ab|cd)*$", "");
+    ASSERT_MATCH("^(ab|cd)*$", "abcd");
+    ASSERT_NO_MATCH("^(ab|cd)*$", "abc");
+    ASSERT_MATCH("a(b|c)?d$", "xxad");
+    ASSERT_NO_MATCH("a(b|c)?d$", "xxad ");
+    ASSERT_MATCH_WITH_FLAGS("a.c", "s", "a\nc");
+    ASSERT_NO_MATCH("a.c", "a\nc");
+}
@@ -128,4 +128,21 @@ void test_case_insensitive_character_classes(void) {
     ASSERT_MATCH_WITH_FLAGS("[a-z]+", "i", "HELLO");
     ASSERT_MATCH_WITH_FLAGS("[A-Z]*", "i", "hello");
     ASSERT_MATCH_WITH_FLAGS("[a-z]?", "i", "X");
+}
+
+void test_compact_bytecode(void) {
+    // Instructions stay within 8 bytes; classes live once in a shared pool
+    TEST_ASSERT_TRUE(sizeof(Instruction) <= 8);
+
+    RegExp *re = regex_new("[a-c]x[a-c]y\\d\\d[^a-c]", "");
+    TEST_ASSERT_EQUAL_INT(2, re->compiled->charset_count);
+    TEST_ASSERT_TRUE(regex_test(re, "..axcy42z"));
+    TEST_ASSERT_FALSE(regex_test(re, "axcy42a"));
+    regex_free(re);
+
+    // Under i the pool holds the folded class, matched by every engine
+    re = regex_new("[a-c]+[A-C]+", "i");
+    TEST_ASSERT_EQUAL_INT(1, re->compiled->charset_count);
+    assert_exec_each_engine(re, "xxAbCa!", 2, "AbCa");
+    regex_free(re);
 }
\ No newline at end of file
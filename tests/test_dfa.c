@@ -0,0 +1,220 @@
+#include "test_shared.h"
+
+static const char *dfa_cases[][4] = {
+    // pattern, flags, text, expected ("1" or "0")
+    {"hello", "", "say hello world", "1"},
+    {"hello", "i", "SAY HELLO", "1"},
+    {"^abc", "", "xabc", "0"},
+    {"^abc", "m", "x\nabc", "1"},
+    {"abc$", "", "abc\nx", "0"},
+    {"abc$", "m", "abc\nx", "1"},
+    {"\\bcat\\b", "", "concatenate", "0"},
+    {"\\bcat\\b", "", "a cat sat", "1"},
+    {"\\Bcat\\B", "", "concatenate", "1"},
+    {"a.c", "", "a\nc", "0"},
+    {"a.c", "s", "a\nc", "1"},
+    {"[^0-9]+$", "", "123abc", "1"},
+    {"\\d{3}-\\d{4}", "", "call 555-1234", "1"},
+    {"(a|b)*c", "", "ababab", "0"},
+    {"", "", "anything", "1"},
+};
+
+// The lazy DFA behind regex_test must agree with the capture engine
+void test_dfa_matches_vm(void) {
+    int case_count = sizeof(dfa_cases) / sizeof(dfa_cases[0]);
+
+    for (int i = 0; i < case_count; i++) {
+        RegExp *re = regex_new(dfa_cases[i][0], dfa_cases[i][1]);
+        int expected = dfa_cases[i][3][0] == '1';
+
+        TEST_ASSERT_EQUAL_INT_MESSAGE(expected, regex_test(re, dfa_cases[i][2]), dfa_cases[i][0]);
+
+        MatchResult *result = regex_exec(re, dfa_cases[i][2]);
+        TEST_ASSERT_EQUAL_INT_MESSAGE(expected, result != NULL, dfa_cases[i][0]);
+        match_result_free(result);
+
+        regex_free(re);
+    }
+}
+
+void test_dfa_cache_stays_warm(void) {
+    // \b keeps the bit-parallel engine out of the way
+    RegExp *re = regex_new("\\b[a-z]+@[a-z]+\\.com", "");
+    TEST_ASSERT_NULL(re->compiled->dfa);
+
+    TEST_ASSERT_TRUE(regex_test(re, "mail bob@example.com today"));
+    TEST_ASSERT_NOT_NULL(re->compiled->dfa);
+
+    // Second call reuses the cached states
+    struct LazyDFA *dfa = re->compiled->dfa;
+    TEST_ASSERT_FALSE(regex_test(re, "no address here"));
+    TEST_ASSERT_EQUAL_PTR(dfa, re->compiled->dfa);
+
+    regex_free(re);
+}
+
+// A tiny cache forces flushes and the VM fallback; answers must not change
+void test_dfa_cache_limit(void) {
+    int case_count = sizeof(dfa_cases) / sizeof(dfa_cases[0]);
+
+    for (int i = 0; i < case_count; i++) {
+        RegExp *re = regex_new(dfa_cases[i][0], dfa_cases[i][1]);
+        re->compiled->dfa_cache_limit = 1;
+        int expected = dfa_cases[i][3][0] == '1';
+
+        TEST_ASSERT_EQUAL_INT_MESSAGE(expected, regex_test(re, dfa_cases[i][2]), dfa_cases[i][0]);
+        regex_free(re);
+    }
+}
+
+static const struct {
+    const char *pattern;
+    const char *flags;
+    const char *text;
+    const char *match;  // NULL for none
+    int index;
+} span_cases[] = {
+    {"a+", "", "xaaay", "aaa", 1},
+    {"(a|ab)(c|bcd)", "", "xabcd", "abcd", 1},
+    {"\\bfoo\\w*", "", "afoo foobar", "foobar", 5},
+    {"(\\w+)@(\\w+)\\.com", "", "mail: bob@example.com!", "bob@example.com", 6},
+    {"^b.*$", "m", "ab\nbc\nb", "bc", 3},
+    {"x*", "", "abc", "", 0},
+    {"(a|b)*abb", "", "ababababb", "ababababb", 0},
+    {"c$", "", "cabc", "c", 3},
+    {"q", "", "no match here", NULL, 0},
+};
+
+// execute_regex_detailed finds the span with the lazy DFAs first and only
+// runs the capture engine from its start; with the caches too small to hold
+// a state it falls back to trying every start position
+void test_dfa_match_span(void) {
+    int case_count = sizeof(span_cases) / sizeof(span_cases[0]);
+
+    for (int limit = 0; limit < 2; limit++) {
+        for (int i = 0; i < case_count; i++) {
+            RegExp *re = regex_new(span_cases[i].pattern, span_cases[i].flags);
+            TEST_ASSERT_NULL(re->compiled->reverse);  // Compiled by the first span search
+            if (limit) re->compiled->dfa_cache_limit = 1;
+
+            MatchResult *result = regex_exec(re, span_cases[i].text);
+            if (span_cases[i].match) {
+                TEST_ASSERT_NOT_NULL_MESSAGE(result, span_cases[i].pattern);
+                TEST_ASSERT_EQUAL_STRING_MESSAGE(span_cases[i].match, result->groups[0], span_cases[i].pattern);
+                TEST_ASSERT_EQUAL_INT_MESSAGE(span_cases[i].index, result->index, span_cases[i].pattern);
+            } else {
+                TEST_ASSERT_NULL_MESSAGE(result, span_cases[i].pattern);
+            }
+            match_result_free(result);
+            regex_free(re);
+        }
+    }
+
+    // Later searches of a global regex see the byte before last_index
+    RegExp *re = regex_new("\\bab", "g");
+    MatchResult *result = regex_exec(re, "ab cab ab");
+    TEST_ASSERT_EQUAL_INT(0, result->index);
+    match_result_free(result);
+    result = regex_exec(re, "ab cab ab");
+    TEST_ASSERT_EQUAL_INT(7, result->index);
+    match_result_free(result);
+    regex_free(re);
+    // Yes/no answers never need the reverse program
+    re = regex_new("(\\w+)@example", "");
+    TEST_ASSERT_TRUE(regex_test(re, "mail bob@example now"));
+    TEST_ASSERT_NULL(re->compiled->reverse);
+    result = regex_exec(re, "mail bob@example now");
+    TEST_ASSERT_NOT_NULL(re->compiled->reverse);
+    TEST_ASSERT_EQUAL_STRING("bob", result->groups[1]);
+    match_result_free(result);
+    regex_free(re);
+}
+
+// [b][c], optionally followed by $, built node by node
+static ASTNode* span_ast(int anchored) {
+    ASTNode *sequence = create_ast_node(AST_SEQUENCE);
+    sequence->data.sequence.child_count = anchored ? 3 : 2;
+    sequence->data.sequence.capacity = 3;
+    sequence->data.sequence.children = malloc(3 * sizeof(ASTNode*));
+    for (int i = 0; i < 2; i++) {
+        ASTNode *charset = create_ast_node(AST_CHARSET);
+        unsigned char c = i ? 'c' : 'b';
+        charset->data.charset.charset[c / 8] |= 1 << (c % 8);
+        sequence->data.sequence.children[i] = charset;
+    }
+    if (anchored) sequence->data.sequence.children[2] = create_ast_node(AST_ANCHOR_END);
+    return sequence;
+}
+
+// Patterns compiled from an AST have no source to build the reverse program
+// from later, so compile_ast builds it with the rest
+void test_dfa_span_from_ast(void) {
+    ASTNode *ast = span_ast(1);
+    CompiledRegex *compiled = compile_ast(ast, 0);
+    free_ast(ast);
+    TEST_ASSERT_NOT_NULL(compiled->reverse);
+    TEST_ASSERT_FALSE(execute_regex(compiled, "xyz", 0));
+    TEST_ASSERT_FALSE(execute_regex(compiled, "bcx", 0));
+    TEST_ASSERT_TRUE(execute_regex(compiled, "abc", 0));
+    free_regex(compiled);
+
+    RegExp *re = regex_new("q", "");
+    free_regex(re->compiled);
+    ast = span_ast(0);
+    re->compiled = compile_ast(ast, 0);
+    free_ast(ast);
+    MatchResult *result = regex_exec(re, "aaabc");
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL_INT(3, result->index);
+    TEST_ASSERT_EQUAL_STRING("bc", result->groups[0]);
+    match_result_free(result);
+    TEST_ASSERT_NULL(regex_exec(re, "abab"));
+    regex_free(re);
+}
+
+void test_full_dfa_matches_vm(void) {
+    int case_count = sizeof(dfa_cases) / sizeof(dfa_cases[0]);
+
+    for (int i = 0; i < case_count; i++) {
+        int flags = 0;
+        for (const char *f = dfa_cases[i][1]; *f; f++) {
+            if (*f == 's') flags |= 1;
+            if (*f == 'i') flags |= 2;
+            if (*f == 'm') flags |= 8;
+        }
+
+        CompiledRegex *compiled = compile_regex_dfa(dfa_cases[i][0], flags, 0);
+        TEST_ASSERT_NOT_NULL(compiled);
+        TEST_ASSERT_NOT_NULL_MESSAGE(compiled->full_dfa, dfa_cases[i][0]);
+
+        int expected = dfa_cases[i][3][0] == '1';
+        TEST_ASSERT_EQUAL_INT_MESSAGE(expected, execute_regex(compiled, dfa_cases[i][2], 0), dfa_cases[i][0]);
+        free_regex(compiled);
+    }
+}
+
+// Equivalent patterns minimize to the same table
+void test_full_dfa_minimization(void) {
+    CompiledRegex *plain = compile_regex_dfa("abc", 0, 0);
+    CompiledRegex *redundant = compile_regex_dfa("abc|abc|a(b)c", 0, 0);
+    TEST_ASSERT_NOT_NULL(plain->full_dfa);
+    TEST_ASSERT_NOT_NULL(redundant->full_dfa);
+    TEST_ASSERT_EQUAL_INT(plain->full_dfa->state_count, redundant->full_dfa->state_count);
+
+    TEST_ASSERT_TRUE(execute_regex(redundant, "xxabcxx", 0));
+    TEST_ASSERT_FALSE(execute_regex(redundant, "xxabxcx", 0));
+
+    free_regex(plain);
+    free_regex(redundant);
+}
+
+// Exceeding the state limit leaves full_dfa unset; matching still works
+void test_full_dfa_state_limit(void) {
+    CompiledRegex *compiled = compile_regex_dfa("[ab]*a[ab]{8}", 0, 16);
+    TEST_ASSERT_NOT_NULL(compiled);
+    TEST_ASSERT_NULL(compiled->full_dfa);
+
+    TEST_ASSERT_TRUE(execute_regex(compiled, "bbbabbbbbbbbb", 0));
+    TEST_ASSERT_FALSE(execute_regex(compiled, "bbbbbbbbbbbbb", 0));
+    free_regex(compiled);
+}
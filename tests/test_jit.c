@@ -0,0 +1,78 @@
+#include "test_shared.h"
+
+static RegExp* jit_regex_new(const char *pattern, const char *flags) {
+    RegExp *re = regex_new(pattern, flags);
+    TEST_ASSERT_NOT_NULL(re->compiled);
+    if (!regex_jit_compile(re->compiled)) {
+        regex_free(re);
+        return NULL;
+    }
+    return re;
+}
+
+// Native code must give the interpreter's exact matches and captures
+void test_jit_matches_interpreter(void) {
+    const char *cases[][3] = {
+        // pattern, flags, text
+        {"(\\w+)\\s(\\w+)", "", "hello big world"},
+        {"(ab|a)(c|bcd)(d*)", "", "xabcdd"},
+        {"([a-z]+|[0-9]+)*x", "", "abc123def456x"},
+        {"^(\\d+)-(\\d+)$", "m", "x\n12-34\ny"},
+        {"\\bcat\\B", "", "cat catalog"},
+        {"[A-Z]+", "i", "123 hello"},
+        {"a.c", "s", "a\nc"},
+        {"a.c", "", "a\nc abc"},
+        {"colou?r", "", "no match here"},
+        {"(b?)+", "", "b"},
+    };
+    int case_count = sizeof(cases) / sizeof(cases[0]);
+
+    for (int i = 0; i < case_count; i++) {
+        RegExp *plain = regex_new(cases[i][0], cases[i][1]);
+        RegExp *jit = jit_regex_new(cases[i][0], cases[i][1]);
+        if (!jit) {
+            regex_free(plain);
+            TEST_IGNORE_MESSAGE("JIT not available on this platform");
+        }
+
+        MatchResult *expected = regex_exec(plain, cases[i][2]);
+        MatchResult *actual = regex_exec(jit, cases[i][2]);
+        TEST_ASSERT_EQUAL_INT_MESSAGE(expected != NULL, actual != NULL, cases[i][0]);
+        if (expected && actual) {
+            TEST_ASSERT_EQUAL_INT_MESSAGE(expected->index, actual->index, cases[i][0]);
+            TEST_ASSERT_EQUAL_INT(expected->group_count, actual->group_count);
+            for (int g = 0; g < expected->group_count; g++) {
+                if (expected->groups[g]) {
+                    TEST_ASSERT_EQUAL_STRING_MESSAGE(expected->groups[g], actual->groups[g], cases[i][0]);
+                } else {
+                    TEST_ASSERT_NULL_MESSAGE(actual->groups[g], cases[i][0]);
+                }
+            }
+        }
+        TEST_ASSERT_EQUAL_INT_MESSAGE(regex_test(plain, cases[i][2]), regex_test(jit, cases[i][2]), cases[i][0]);
+
+        match_result_free(expected);
+        match_result_free(actual);
+        regex_free(plain);
+        regex_free(jit);
+    }
+}
+
+// Deep backtracking outgrows the initial stack; the search is retried
+void test_jit_stack_growth(void) {
+    RegExp *re = jit_regex_new("((a|b)*)c", "");
+    if (!re) TEST_IGNORE_MESSAGE("JIT not available on this platform");
+
+    char text[4001];
+    for (int i = 0; i < 4000; i++) text[i] = i % 2 ? 'a' : 'b';
+    text[4000] = '\0';
+    TEST_ASSERT_NULL(regex_exec(re, text));
+
+    text[3999] = 'c';
+    MatchResult *result = regex_exec(re, text);
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL_INT(0, result->index);
+    TEST_ASSERT_EQUAL_INT(3999, (int)strlen(result->groups[1]));
+    match_result_free(result);
+    regex_free(re);
+}
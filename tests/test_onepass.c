@@ -0,0 +1,61 @@
+#include "test_shared.h"
+
+void test_onepass_eligibility(void) {
+    const char *eligible[] = {"(\\w+)@(\\w+)\\.(\\w+)", "([a-z]+)=([0-9]*)", "^(\\d{4})-(\\d{2})$", "a(bc)?", "x|y(z)"};
+    const char *ineligible[] = {"(a|ab)c", "(.*)x", "(a*)*", "(\\w+)(\\d)", "(a?|b?)c"};
+
+    for (int i = 0; i < (int)(sizeof(eligible) / sizeof(eligible[0])); i++) {
+        RegExp *re = regex_new(eligible[i], "");
+        TEST_ASSERT_NOT_NULL_MESSAGE(re->compiled->onepass, eligible[i]);
+        regex_free(re);
+    }
+
+    for (int i = 0; i < (int)(sizeof(ineligible) / sizeof(ineligible[0])); i++) {
+        RegExp *re = regex_new(ineligible[i], "");
+        TEST_ASSERT_NULL_MESSAGE(re->compiled->onepass, ineligible[i]);
+        regex_free(re);
+    }
+}
+
+void test_onepass_captures(void) {
+    ASSERT_GROUP_MATCH("(\\w+)@(\\w+)\\.(\\w+)", "mail bob@example.com now", 1, "bob");
+    ASSERT_GROUP_MATCH("(\\w+)@(\\w+)\\.(\\w+)", "mail bob@example.com now", 2, "example");
+    ASSERT_GROUP_MATCH("(\\w+)@(\\w+)\\.(\\w+)", "mail bob@example.com now", 3, "com");
+    ASSERT_GROUP_MATCH("([a-z]+)=([0-9]*)", "x; key=", 1, "key");
+    ASSERT_GROUP_MATCH("([a-z]+)=([0-9]*)", "x; key=", 2, "");
+    ASSERT_GROUP_MATCH("x|y(z)", "yz", 1, "z");
+    ASSERT_GROUP_MATCH("x|y(z)", "xyz", 1, NULL);
+
+    // The last iteration of a repeated group wins
+    ASSERT_GROUP_MATCH("(([a-c])x)+", "axbxcy", 2, "b");
+}
+
+// When the preferred path dies the remembered lower-priority MATCH is used
+void test_onepass_fallback_match(void) {
+    RegExp *re = regex_new("a(bc)?", "");
+    TEST_ASSERT_NOT_NULL(re->compiled->onepass);
+
+    MatchResult *result = regex_exec(re, "zabd");
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL_INT(1, result->index);
+    TEST_ASSERT_EQUAL_STRING("a", result->groups[0]);
+    TEST_ASSERT_NULL(result->groups[1]);
+    match_result_free(result);
+
+    result = regex_exec(re, "zabc");
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL_STRING("abc", result->groups[0]);
+    TEST_ASSERT_EQUAL_STRING("bc", result->groups[1]);
+    match_result_free(result);
+    regex_free(re);
+
+    // Assertions on the path are checked at match time
+    re = regex_new("^(\\d{4})-(\\d{2})$", "");
+    TEST_ASSERT_NOT_NULL(re->compiled->onepass);
+    TEST_ASSERT_NULL(regex_exec(re, "2024-011"));
+    result = regex_exec(re, "2024-01");
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL_STRING("01", result->groups[2]);
+    match_result_free(result);
+    regex_free(re);
+}
@@ -40,4 +40,75 @@ void test_large_input(void) {
     
     free(large_text);
     regex_free(re);
-}
\ No newline at end of file
+}
+
+void test_backtracker_memoization(void) {
+    // Captures go through the backtracker; the visited set keeps these
+    // polynomial instead of relying on the choice limit
+    RegExp *re = regex_new("(a+)+b", "");
+    TEST_ASSERT_NULL(regex_exec(re, "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaac"));
+    regex_free(re);
+
+    // Exhausting the first alternative used to trip the choice limit and
+    // hide the match found by the second
+    re = regex_new("((a|a)*c|a*)d", "");
+    MatchResult *result = regex_exec(re, "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaad");
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL_INT(0, result->index);
+    TEST_ASSERT_EQUAL_STRING("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaad", result->groups[0]);
+    match_result_free(result);
+    regex_free(re);
+
+    // Empty iterations no longer loop until a limit is hit
+    re = regex_new("(b?)+", "");
+    result = regex_exec(re, "b");
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL_STRING("b", result->groups[0]);
+    match_result_free(result);
+    regex_free(re);
+
+    // Texts too long for one visited bitset keep it in blocks
+    int len = 200000;
+    char *text = malloc(len + 1);
+    memset(text, 'a', len);
+    memcpy(text + len - 5, "@mail", 5);
+    text[len] = '\0';
+    re = regex_new("(\\w+)@", "");
+    result = regex_exec(re, text);
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL_INT(0, result->index);
+    match_result_free(result);
+    regex_free(re);
+    free(text);
+}
+
+void test_threaded_superinstructions(void) {
+    // Literal runs, + loops and * loop heads are fused by the threaded
+    // interpreter; these patterns are ambiguous so they reach it
+    RegExp *re = regex_new("(\\w+)(\\w+)@example", "");
+    MatchResult *result = regex_exec(re, "mail: someone@example.com");
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL_INT(6, result->index);
+    TEST_ASSERT_EQUAL_STRING("someon", result->groups[1]);
+    TEST_ASSERT_EQUAL_STRING("e", result->groups[2]);
+    match_result_free(result);
+    regex_free(re);
+
+    // A run cut short by the end of the text, then retried from the loop
+    re = regex_new("(ab|a)*abcd", "");
+    result = regex_exec(re, "abababcabcd");
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL_INT(7, result->index);
+    TEST_ASSERT_EQUAL_STRING("abcd", result->groups[0]);
+    match_result_free(result);
+    TEST_ASSERT_NULL(regex_exec(re, "ababab"));
+    regex_free(re);
+
+    // Case-folded letters leave the exact-byte run
+    re = regex_new("(\\w*)HELLO-world", "i");
+    result = regex_exec(re, "xxhello-WORLD");
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL_STRING("xx", result->groups[1]);
+    match_result_free(result);
+    regex_free(re);
+}
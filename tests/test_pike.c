@@ -0,0 +1,106 @@
+#include "test_shared.h"
+
+static RegExp* pike_regex_new(const char *pattern, const char *flags) {
+    RegExp *re = regex_new(pattern, flags);
+    TEST_ASSERT_NOT_NULL(re->compiled);
+    re->compiled->engine = REGEX_ENGINE_PIKE;
+    return re;
+}
+
+// The Pike VM must give the same leftmost-first answers as the backtracker
+void test_pike_matches_backtracker(void) {
+    const char *cases[][3] = {
+        {"(\\w+)\\s+(\\w+)", "", "  hello world"},
+        {"(a|ab)(c|bcd)(d*)", "", "abcd"},
+        {"(\\d{3})[- ]?(\\d{4})", "", "call 555-1234 now"},
+        {"^(\\w+)@(\\w+)\\.com$", "", "user@example.com"},
+        {"(a)|b", "", "b"},
+        {"(a)*", "", "aab"},
+        {"\\bworld\\b", "i", "Hello WORLD"},
+        {"^b$", "m", "a\nb\nc"},
+        {"a.c", "s", "a\nc"},
+        {"[a-z]+(\\d{1,2})?", "i", "ABC123"},
+        // Loops whose body can match empty
+        {"(^)*", "", "x"},
+        {"b|(^|\\d|[^a])+", "", ".1A"},
+        {"(b?|[ab]+x)*.{2,}", "", "cxAB"},
+        {"(a|\\b)*c", "", "abac"},
+        {"((a)|b?)+c", "", "abac"},
+    };
+    int case_count = sizeof(cases) / sizeof(cases[0]);
+
+    for (int i = 0; i < case_count; i++) {
+        RegExp *backtrack = regex_new(cases[i][0], cases[i][1]);
+        RegExp *pike = pike_regex_new(cases[i][0], cases[i][1]);
+
+        TEST_ASSERT_EQUAL_INT(regex_test(backtrack, cases[i][2]), regex_test(pike, cases[i][2]));
+
+        MatchResult *expected = regex_exec(backtrack, cases[i][2]);
+        MatchResult *actual = regex_exec(pike, cases[i][2]);
+        TEST_ASSERT_NOT_NULL(expected);
+        TEST_ASSERT_NOT_NULL(actual);
+        TEST_ASSERT_EQUAL_INT(expected->index, actual->index);
+        TEST_ASSERT_EQUAL_INT(expected->group_count, actual->group_count);
+        for (int g = 0; g < expected->group_count; g++) {
+            if (expected->groups[g]) {
+                TEST_ASSERT_EQUAL_STRING(expected->groups[g], actual->groups[g]);
+            } else {
+                TEST_ASSERT_NULL(actual->groups[g]);
+            }
+        }
+
+        match_result_free(expected);
+        match_result_free(actual);
+        regex_free(backtrack);
+        regex_free(pike);
+    }
+
+    // An empty iteration still sets its captures, and a loop entered empty
+    // goes on to its other alternatives
+    RegExp *pike = pike_regex_new("(^)*", "");
+    MatchResult *result = regex_exec(pike, "x");
+    TEST_ASSERT_EQUAL_STRING("", result->groups[1]);
+    match_result_free(result);
+    regex_free(pike);
+
+    pike = pike_regex_new("b|(^|\\d|[^a])+", "");
+    result = regex_exec(pike, ".1A");
+    TEST_ASSERT_EQUAL_STRING(".1A", result->groups[0]);
+    TEST_ASSERT_EQUAL_STRING("A", result->groups[1]);
+    match_result_free(result);
+    regex_free(pike);
+}
+
+void test_pike_pathological_patterns(void) {
+    RegExp *re = pike_regex_new("(a+)+b", "");
+    TEST_ASSERT_FALSE(regex_test(re, "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaac"));
+    TEST_ASSERT_TRUE(regex_test(re, "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab"));
+    regex_free(re);
+
+    // The first alternative explodes before the second one can succeed; the
+    // Pike VM has no cutoff, so it still reports the leftmost match
+    re = pike_regex_new("((a|a)*c|a*)d", "");
+    MatchResult *result = regex_exec(re, "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaad");
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL_INT(0, result->index);
+    TEST_ASSERT_EQUAL_STRING("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaad", result->groups[0]);
+    match_result_free(result);
+    regex_free(re);
+}
+
+void test_pike_global_iteration(void) {
+    RegExp *re = pike_regex_new("\\d+", "g");
+    const char *expected[] = {"123", "456", "789"};
+    MatchResult *result;
+    int count = 0;
+
+    while ((result = regex_exec(re, "123 abc 456 def 789")) != NULL) {
+        TEST_ASSERT_LESS_THAN(3, count);
+        TEST_ASSERT_EQUAL_STRING(expected[count], result->groups[0]);
+        match_result_free(result);
+        count++;
+    }
+
+    TEST_ASSERT_EQUAL_INT(3, count);
+    regex_free(re);
+}
@@ -0,0 +1,211 @@
+#include "test_shared.h"
+
+void test_plan_analysis(void) {
+    RegExp *re = regex_new("^(ab|cd)+x$", "");
+    RegexPlan *plan = &re->compiled->plan;
+    TEST_ASSERT_TRUE(plan->anchored_start);
+    TEST_ASSERT_TRUE(plan->anchored_end);
+    TEST_ASSERT_EQUAL_INT(0, plan->literal_length);
+    TEST_ASSERT_EQUAL_INT(1, plan->capture_count);
+    TEST_ASSERT_TRUE(plan->backtrack_sensitive);
+    regex_free(re);
+
+    re = regex_new("ERROR:", "");
+    plan = &re->compiled->plan;
+    TEST_ASSERT_FALSE(plan->anchored_start);
+    TEST_ASSERT_FALSE(plan->anchored_end);
+    TEST_ASSERT_EQUAL_INT(6, plan->literal_length);
+    TEST_ASSERT_EQUAL_INT(0, plan->capture_count);
+    TEST_ASSERT_FALSE(plan->backtrack_sensitive);
+    regex_free(re);
+
+    // Only an anchor on every alternative counts
+    re = regex_new("^a|b", "");
+    TEST_ASSERT_FALSE(re->compiled->plan.anchored_start);
+    regex_free(re);
+
+    const char *sensitive[] = {"(a+)+b", "(b?)*", "(\\w+\\s?)*$", "(a|ab)*c"};
+    const char *linear[] = {"(\\w+)@(\\w+)", "a*b*c*", "(ab){2,5}", "x(y|z)+"};
+    for (int i = 0; i < (int)(sizeof(sensitive) / sizeof(sensitive[0])); i++) {
+        re = regex_new(sensitive[i], "");
+        TEST_ASSERT_TRUE_MESSAGE(re->compiled->plan.backtrack_sensitive, sensitive[i]);
+        regex_free(re);
+    }
+    for (int i = 0; i < (int)(sizeof(linear) / sizeof(linear[0])); i++) {
+        re = regex_new(linear[i], "");
+        TEST_ASSERT_FALSE_MESSAGE(re->compiled->plan.backtrack_sensitive, linear[i]);
+        regex_free(re);
+    }
+}
+
+void test_plan_routing(void) {
+    // Short pattern: bit-parallel yes/no; no groups, so the span is the answer
+    RegExp *re = regex_new("\\d{3}-\\d{4}", "");
+    RegexPlan *plan = &re->compiled->plan;
+    TEST_ASSERT_EQUAL_INT(REGEX_MATCHER_BITNFA, plan->test);
+    TEST_ASSERT_TRUE(plan->span_only);
+    MatchResult *result = regex_exec(re, "call 555-1234 now");
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL_STRING("555-1234", result->groups[0]);
+    TEST_ASSERT_EQUAL_INT(REGEX_MATCHER_SPAN_DFA, regex_scratch_last_exec(re->compiled->scratch));
+    match_result_free(result);
+    regex_free(re);
+
+    // One-pass captures after the span is found
+    re = regex_new("(\\w+)@(\\w+)\\.com", "");
+    plan = &re->compiled->plan;
+    TEST_ASSERT_TRUE(plan->find_span);
+    TEST_ASSERT_FALSE(plan->span_only);
+    TEST_ASSERT_EQUAL_INT(re->compiled->jit ? REGEX_MATCHER_JIT : REGEX_MATCHER_ONEPASS, plan->exec);
+    regex_free(re);
+
+    // Ambiguous captures backtrack (natively in JIT builds); choosing the
+    // Pike VM later replaces the interpreter
+    re = regex_new("(a|ab)(c|bcd)(d*)", "");
+    plan = &re->compiled->plan;
+    RegexMatcher backtracker = re->compiled->jit ? REGEX_MATCHER_JIT : REGEX_MATCHER_BACKTRACK;
+    TEST_ASSERT_EQUAL_INT(backtracker, plan->exec);
+    result = regex_exec(re, "xabcd");
+    TEST_ASSERT_EQUAL_STRING("bcd", result->groups[2]);
+    TEST_ASSERT_EQUAL_INT(backtracker, regex_scratch_last_exec(re->compiled->scratch));
+    match_result_free(result);
+
+    re->compiled->engine = REGEX_ENGINE_PIKE;
+    result = regex_exec(re, "xabcd");
+    TEST_ASSERT_EQUAL_STRING("bcd", result->groups[2]);
+    TEST_ASSERT_EQUAL_INT(re->compiled->jit ? REGEX_MATCHER_JIT : REGEX_MATCHER_PIKE,
+                          regex_scratch_last_exec(re->compiled->scratch));
+    TEST_ASSERT_EQUAL_INT(backtracker, plan->exec);  // Chosen per call, not re-routed
+    match_result_free(result);
+    regex_free(re);
+
+    // The interpreter keeps a linear pattern's visited set in blocks and a
+    // sensitive one's in a single bitset
+    re = regex_new("(a|ab)(c|bcd)(d*)", "");
+    TEST_ASSERT_EQUAL_INT(!re->compiled->jit, re->compiled->plan.visited_blocks);
+    result = regex_exec(re, "xabcd");
+    TEST_ASSERT_EQUAL_STRING("bcd", result->groups[2]);
+    match_result_free(result);
+    regex_free(re);
+    re = regex_new("(a|ab)*(c)", "");
+    TEST_ASSERT_FALSE(re->compiled->plan.visited_blocks);
+    regex_free(re);
+
+    // A caller's scratch records what its calls ran; the pattern is not
+    // written to
+    re = regex_new("(a|ab)(c|bcd)(d*)", "");
+    RegexScratch *scratch = regex_scratch_new(re->compiled);
+    TEST_ASSERT_EQUAL_INT(REGEX_MATCHER_NONE, regex_scratch_last_exec(scratch));
+    result = regex_exec_scratch(re, "xabcd", scratch);
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL_INT(backtracker, regex_scratch_last_exec(scratch));
+    TEST_ASSERT_FALSE(regex_test_scratch(re, "xyz", scratch));
+    TEST_ASSERT_EQUAL_INT(re->compiled->plan.test, regex_scratch_last_test(scratch));
+    TEST_ASSERT_NULL(re->compiled->scratch);
+    match_result_free(result);
+    regex_scratch_free(scratch);
+    regex_free(re);
+
+    // Texts too long for one visited bitset stay on the interpreter, which
+    // keeps the bitset in blocks
+    int len = 200000;
+    char *text = malloc(len + 1);
+    memset(text, 'a', len);
+    memcpy(text + len - 4, "abcd", 4);
+    text[len] = '\0';
+    re = regex_new("(a|ab)(c|bcd)(d*)", "");
+    plan = &re->compiled->plan;
+    result = regex_exec(re, text);
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL_INT(len - 4, result->index);
+    TEST_ASSERT_EQUAL_INT(REGEX_MATCHER_BACKTRACK, regex_scratch_last_exec(re->compiled->scratch));
+    match_result_free(result);
+    regex_free(re);
+    free(text);
+
+    // A finished table takes over yes/no matching
+    CompiledRegex *compiled = compile_regex_dfa("^[A-Z]{2}\\d+$", 0, 0);
+    TEST_ASSERT_EQUAL_INT(REGEX_MATCHER_FULL_DFA, compiled->plan.test);
+    TEST_ASSERT_TRUE(execute_regex(compiled, "AB1234", 0));
+    TEST_ASSERT_EQUAL_INT(REGEX_MATCHER_FULL_DFA, regex_scratch_last_test(compiled->scratch));
+    free_regex(compiled);
+}
+
+void test_match_length_bounds(void) {
+    const char *patterns[] = {"abc", "a{2,4}b?", "(\\d+)-x", "\\bfoo|ba(r|zz)\\b", "^$", ""};
+    int mins[] = {3, 2, 3, 3, 0, 0};
+    int maxes[] = {3, 5, -1, 4, 0, 0};
+
+    for (int i = 0; i < 6; i++) {
+        RegExp *re = regex_new(patterns[i], "");
+        TEST_ASSERT_EQUAL_INT_MESSAGE(mins[i], re->compiled->min_length, patterns[i]);
+        TEST_ASSERT_EQUAL_INT_MESSAGE(maxes[i], re->compiled->max_length, patterns[i]);
+        regex_free(re);
+    }
+
+    // Texts, and what is left of them after last_index, shorter than the
+    // shortest match are turned away; the rest is still searched to the end
+    RegExp *re = regex_new("(\\w+)-(\\d{3})", "g");
+    TEST_ASSERT_FALSE(regex_test(re, "ab-12"));
+    assert_exec_each_engine(re, "ab-123 cd-456", 0, "ab-123");
+    assert_exec_each_engine(re, "ab-123 cd-456", 7, "cd-456");
+    assert_exec_each_engine(re, "ab-123 cd-456", -1, NULL);
+    regex_free(re);
+
+    // A bounded pattern ending at $ is only tried near the end of the text
+    char text[2001];
+    memset(text, '5', sizeof(text) - 1);
+    text[sizeof(text) - 1] = '\0';
+    memcpy(text + sizeof(text) - 9, "555-0123", 8);
+    re = regex_new("(\\d{3})-\\d{4}$", "");
+    MatchResult *result = regex_exec(re, text);
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL_INT((int)sizeof(text) - 9, result->index);
+    TEST_ASSERT_EQUAL_STRING("555", result->groups[1]);
+    match_result_free(result);
+    text[sizeof(text) - 2] = 'x';
+    TEST_ASSERT_FALSE(regex_test(re, text));
+    regex_free(re);
+
+    // Under m, $ also matches before each '\n', so every offset stays in play
+    re = regex_new("\\d{3}$", "m");
+    TEST_ASSERT_TRUE(regex_test(re, "123\nabcdefgh"));
+    regex_free(re);
+}
+
+void test_plan_pinning(void) {
+    // A pinned matcher runs alone and outlives later routing
+    RegExp *re = regex_new("(\\w+)@(\\w+)\\.com", "");
+    TEST_ASSERT_TRUE(regex_pin_matcher(re->compiled, REGEX_MATCHER_PIKE));
+    TEST_ASSERT_EQUAL_INT(REGEX_MATCHER_PIKE, re->compiled->plan.exec);
+    TEST_ASSERT_FALSE(re->compiled->plan.find_span);
+    regex_jit_compile(re->compiled);
+    TEST_ASSERT_EQUAL_INT(REGEX_MATCHER_PIKE, re->compiled->plan.exec);
+    MatchResult *result = regex_exec(re, "mail bob@host.com");
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL_STRING("bob", result->groups[1]);
+    TEST_ASSERT_EQUAL_INT(REGEX_MATCHER_PIKE, regex_scratch_last_exec(re->compiled->scratch));
+    match_result_free(result);
+
+    // Only engines that record captures, and only ones that were built
+    TEST_ASSERT_FALSE(regex_pin_matcher(re->compiled, REGEX_MATCHER_LAZY_DFA));
+    TEST_ASSERT_FALSE(regex_pin_matcher(re->compiled, REGEX_MATCHER_SUBSTRING));
+    TEST_ASSERT_EQUAL_INT(REGEX_MATCHER_PIKE, re->compiled->pinned);
+    TEST_ASSERT_TRUE(regex_pin_matcher(re->compiled, REGEX_MATCHER_NONE));
+    TEST_ASSERT_TRUE(re->compiled->plan.find_span);
+    regex_free(re);
+
+    re = regex_new("(a|ab)(c|bcd)", "");
+    TEST_ASSERT_FALSE(regex_pin_matcher(re->compiled, REGEX_MATCHER_ONEPASS));
+    regex_free(re);
+
+    // A literal pattern pinned to a VM leaves its string search
+    re = regex_new("disk full", "");
+    TEST_ASSERT_TRUE(regex_pin_matcher(re->compiled, REGEX_MATCHER_BACKTRACK));
+    result = regex_exec(re, "the disk full of");
+    TEST_ASSERT_NOT_NULL(result);
+    TEST_ASSERT_EQUAL_INT(4, result->index);
+    TEST_ASSERT_EQUAL_INT(REGEX_MATCHER_BACKTRACK, regex_scratch_last_exec(re->compiled->scratch));
+    match_result_free(result);
+    regex_free(re);
+}
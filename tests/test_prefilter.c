@@ -0,0 +1,133 @@
+#include "test_shared.h"
+
+void test_literal_prefix_skip(void) {
+    // Every match starts with one of the extracted literals; near misses
+    // and matches at the very end of the text must survive the skipping
+    const char *text = "GE POS PUT GET/ POST /a x POST /upload";
+    const char *patterns[] = {"(GET|POST) /[a-z]+", "P[OU][ST]T? /\\w+", "\\bPOST /u\\w*d$"};
+
+    for (int i = 0; i < 3; i++) {
+        RegExp *re = regex_new(patterns[i], "");
+        TEST_ASSERT_NOT_NULL(re->compiled->prefix);
+        TEST_ASSERT_TRUE(regex_test(re, text));
+        assert_exec_each_engine(re, text, i == 2 ? 26 : 16, NULL);
+        TEST_ASSERT_FALSE(regex_test(re, "GE POS PUT GET/ POST  /"));
+        regex_free(re);
+    }
+
+    // Patterns that can start with almost anything, or with nothing, get no prefix
+    const char *unprefixed[] = {"a*", ".\\w", "[^,]+", "(ab|c?)", "x?\\D"};
+    for (int i = 0; i < 5; i++) {
+        RegExp *re = regex_new(unprefixed[i], "");
+        TEST_ASSERT_NULL(re->compiled->prefix);
+        regex_free(re);
+    }
+}
+
+void test_first_byte_scan(void) {
+    // With no literal prefix the set of possible first bytes is scanned for
+    // 16 or 32 bytes at a time, including bytes above 0x7f
+    const char *patterns[] = {"\\d+ms", "[A-Z]\\w*:", "a*b", "(x|\xe9)[0-9]"};
+    const char *needles[] = {"12ms", "Key:", "aab", "\xe9" "7"};
+
+    char text[200];
+    for (int i = 0; i < 4; i++) {
+        RegExp *re = regex_new(patterns[i], "");
+        TEST_ASSERT_NOT_NULL(re->compiled->prefix);
+
+        for (int at = 0; at + (int)strlen(needles[i]) < (int)sizeof(text); at += 7) {
+            block_edge_text(text, sizeof(text), NULL, 0, needles[i], at);
+            TEST_ASSERT_TRUE(regex_test(re, text));
+            assert_exec_each_engine(re, text, at, NULL);
+        }
+
+        block_edge_text(text, sizeof(text), NULL, 0, NULL, 0);
+        TEST_ASSERT_FALSE(regex_test(re, text));
+        regex_free(re);
+    }
+}
+
+void test_required_literal(void) {
+    // The literal in the middle decides: missing means no match at all,
+    // present means only starts shortly before it are tried
+    const char *patterns[] = {"\\w+@example\\.com", "\\d{1,3}ms", ".*foo", "(\\w+) failed: (\\w+)"};
+    const char *hits[] = {"mail bob@example.com now", "took 250ms", "xx foo", "job failed: disk"};
+    const char *misses[] = {"mail bob@example.org now", "took 2500 ms", "fo of", "job failed disk"};
+    int indexes[] = {5, 5, 0, 0};
+
+    for (int i = 0; i < 4; i++) {
+        RegExp *re = regex_new(patterns[i], "");
+        TEST_ASSERT_NOT_NULL(re->compiled->prefix);
+        TEST_ASSERT_TRUE(regex_test(re, hits[i]));
+        TEST_ASSERT_FALSE(regex_test(re, misses[i]));
+        assert_exec_each_engine(re, misses[i], -1, NULL);
+        assert_exec_each_engine(re, hits[i], indexes[i], NULL);
+        regex_free(re);
+    }
+
+    // A bounded distance: "ms" far after the digits does not count
+    RegExp *re = regex_new("\\d{1,3}ms", "");
+    assert_exec_each_engine(re, "1 12 123 1234ms 12ms", 10, "234ms");
+    regex_free(re);
+}
+
+void test_multi_literal_prefilter(void) {
+    // Several literals are searched for together, more than 8 sharing the
+    // buckets; the near misses have the right fingerprint and the wrong tail
+    const char *patterns[] = {"timeout|refused|reset by peer|OOM",
+                              "(alpha|beta|gamma|delta|eps|zeta|eta|theta|iota|kappa|lambda) \\d",
+                              "(\xe9t\xe9|\xfc\x62\x65r)s?!"};
+    const char *needles[] = {"reset by peer", "lambda 7", "\xfc\x62\x65rs!"};
+
+    char text[200];
+    for (int i = 0; i < 3; i++) {
+        RegExp *re = regex_new(patterns[i], "");
+        TEST_ASSERT_NOT_NULL(re->compiled->prefix);
+
+        for (int at = 0; at + (int)strlen(needles[i]) < (int)sizeof(text); at += 5) {
+            block_edge_text(text, sizeof(text), "eta-", 11, needles[i], at);
+            TEST_ASSERT_TRUE(regex_test(re, text));
+            assert_exec_each_engine(re, text, at, NULL);
+        }
+
+        block_edge_text(text, sizeof(text), "eta-", 11, NULL, 0);
+        TEST_ASSERT_FALSE(regex_test(re, text));
+        regex_free(re);
+    }
+}
+
+void test_case_insensitive_prefilter(void) {
+    // Under i the literals a match starts with are found in either case,
+    // one literal by the substring searcher and several by Teddy; the near
+    // misses have the right letters and the wrong tail
+    const char *patterns[] = {"Error: (\\w+)", "(connection|socket) reset"};
+    const char *needles[] = {"eRROR: disk", "SOCKET Reset"};
+
+    char text[200];
+    for (int i = 0; i < 2; i++) {
+        RegExp *re = regex_new(patterns[i], "i");
+        TEST_ASSERT_NOT_NULL(re->compiled->prefix);
+
+        for (int at = 0; at + (int)strlen(needles[i]) < (int)sizeof(text); at += 3) {
+            block_edge_text(text, sizeof(text), "ERRORS ", 13, needles[i], at);
+            TEST_ASSERT_TRUE(regex_test(re, text));
+            assert_exec_each_engine(re, text, at, NULL);
+        }
+
+        block_edge_text(text, sizeof(text), "ERRORS ", 13, NULL, 0);
+        TEST_ASSERT_FALSE(regex_test(re, text));
+        regex_free(re);
+    }
+
+    // Character sets are folded too; bytes past ASCII keep their case
+    const char *set_patterns[] = {"[a-c]+", "x[^B]y", "\xe9t\xe9", "[\xc9]"};
+    const char *set_texts[] = {"--CaB--", "xby xBy xcy", "\xc9t\xc9 \xe9T\xe9", "\xe9\xc9"};
+    const char *expected[] = {"CaB", "xcy", "\xe9T\xe9", "\xc9"};
+    int indexes[] = {2, 8, 4, 1};
+
+    for (int i = 0; i < 4; i++) {
+        RegExp *re = regex_new(set_patterns[i], "i");
+        assert_exec_each_engine(re, set_texts[i], indexes[i], expected[i]);
+        regex_free(re);
+    }
+}
@@ -12,10 +12,13 @@ void test_dot_with_dotall_flag(void);
 void test_start_anchor(void);
 void test_end_anchor(void);
 void test_multiline_anchors(void);
+void test_anchored_start_positions(void);
+void test_match_from_end(void);
 
 // Character class tests
 void test_character_classes(void);
 void test_negated_character_classes(void);
+void test_compact_bytecode(void);
 
 // Escape sequence tests
 void test_digit_escape(void);
@@ -53,7 +56,9 @@ void test_global_flag_with_exec(void);
 void test_match_iterator(void);
 void test_match_iterator_requires_global(void);
 void test_comprehensive_match_iterator(void);
+void test_match_spans(void);
 void test_string_match_method(void);
+void test_reusable_scratch(void);
 
 // Word boundary tests
 void test_word_boundary_patterns(void);
@@ -72,10 +77,69 @@ void test_memory_cleanup(void);
 // Performance tests
 void test_pathological_patterns(void);
 void test_large_input(void);
+void test_backtracker_memoization(void);
+void test_threaded_superinstructions(void);
 
 // Integration tests
 void test_complex_integration(void);
 
+// Backtracking VM tests
+void test_long_text_matches_short(void);
+void test_capture_trail(void);
+void test_position_stack(void);
+void test_position_trail(void);
+
+// Pike VM tests
+void test_pike_matches_backtracker(void);
+void test_pike_pathological_patterns(void);
+void test_pike_global_iteration(void);
+
+// Lazy DFA tests
+void test_dfa_matches_vm(void);
+void test_dfa_cache_stays_warm(void);
+void test_dfa_cache_limit(void);
+void test_dfa_match_span(void);
+void test_dfa_span_from_ast(void);
+void test_full_dfa_matches_vm(void);
+void test_full_dfa_minimization(void);
+void test_full_dfa_state_limit(void);
+
+// Bit-parallel NFA tests
+void test_bitnfa_eligibility(void);
+void test_bitnfa_shift_and_patterns(void);
+void test_bitnfa_glushkov_patterns(void);
+
+// Aho-Corasick tests
+void test_aho_corasick_eligibility(void);
+void test_aho_corasick_leftmost_first(void);
+void test_aho_corasick_leftmost_longest(void);
+void test_aho_corasick_keyword_list(void);
+
+// Substring search tests
+void test_substring_search(void);
+
+// One-pass engine tests
+void test_onepass_eligibility(void);
+void test_onepass_captures(void);
+void test_onepass_fallback_match(void);
+
+// JIT tests
+void test_jit_matches_interpreter(void);
+void test_jit_stack_growth(void);
+
+// Planner tests
+void test_plan_analysis(void);
+void test_plan_routing(void);
+void test_match_length_bounds(void);
+void test_plan_pinning(void);
+
+// Prefilter tests
+void test_literal_prefix_skip(void);
+void test_first_byte_scan(void);
+void test_required_literal(void);
+void test_multi_literal_prefilter(void);
+void test_case_insensitive_prefilter(void);
+
 // Unity setup/teardown
 void setUp(void) {
     // Called before each test
@@ -131,10 +195,13 @@ int main(void) {
     RUN_TEST(test_start_anchor);
     RUN_TEST(test_end_anchor);
     RUN_TEST(test_multiline_anchors);
+    RUN_TEST(test_anchored_start_positions);
+    RUN_TEST(test_match_from_end);
 
     // Character classes
     RUN_TEST(test_character_classes);
     RUN_TEST(test_negated_character_classes);
+    RUN_TEST(test_compact_bytecode);
 
     // Escape sequences
     RUN_TEST(test_digit_escape);
@@ -172,7 +239,9 @@ int main(void) {
     RUN_TEST(test_match_iterator);
     RUN_TEST(test_match_iterator_requires_global);
     RUN_TEST(test_comprehensive_match_iterator);
+    RUN_TEST(test_match_spans);
     RUN_TEST(test_string_match_method);
+    RUN_TEST(test_reusable_scratch);
 
     // Word boundary tests
     RUN_TEST(test_word_boundary_patterns);
@@ -190,6 +259,8 @@ int main(void) {
     // Performance
     RUN_TEST(test_pathological_patterns);
     RUN_TEST(test_large_input);
+    RUN_TEST(test_backtracker_memoization);
+    RUN_TEST(test_threaded_superinstructions);
 
     // Memory management
     RUN_TEST(test_memory_cleanup);
@@ -197,6 +268,63 @@ int main(void) {
     // Integration
     RUN_TEST(test_complex_integration);
 
+    // Backtracking VM
+    RUN_TEST(test_long_text_matches_short);
+    RUN_TEST(test_capture_trail);
+    RUN_TEST(test_position_stack);
+    RUN_TEST(test_position_trail);
+
+    // Pike VM engine
+    RUN_TEST(test_pike_matches_backtracker);
+    RUN_TEST(test_pike_pathological_patterns);
+    RUN_TEST(test_pike_global_iteration);
+
+    // Lazy DFA
+    RUN_TEST(test_dfa_matches_vm);
+    RUN_TEST(test_dfa_cache_stays_warm);
+    RUN_TEST(test_dfa_cache_limit);
+    RUN_TEST(test_dfa_match_span);
+    RUN_TEST(test_dfa_span_from_ast);
+    RUN_TEST(test_full_dfa_matches_vm);
+    RUN_TEST(test_full_dfa_minimization);
+    RUN_TEST(test_full_dfa_state_limit);
+
+    // Bit-parallel NFA
+    RUN_TEST(test_bitnfa_eligibility);
+    RUN_TEST(test_bitnfa_shift_and_patterns);
+    RUN_TEST(test_bitnfa_glushkov_patterns);
+
+    // Aho-Corasick
+    RUN_TEST(test_aho_corasick_eligibility);
+    RUN_TEST(test_aho_corasick_leftmost_first);
+    RUN_TEST(test_aho_corasick_leftmost_longest);
+    RUN_TEST(test_aho_corasick_keyword_list);
+
+    // Substring search
+    RUN_TEST(test_substring_search);
+
+    // One-pass engine
+    RUN_TEST(test_onepass_eligibility);
+    RUN_TEST(test_onepass_captures);
+    RUN_TEST(test_onepass_fallback_match);
+
+    // JIT
+    RUN_TEST(test_jit_matches_interpreter);
+    RUN_TEST(test_jit_stack_growth);
+
+    // Planner
+    RUN_TEST(test_plan_analysis);
+    RUN_TEST(test_plan_routing);
+    RUN_TEST(test_match_length_bounds);
+    RUN_TEST(test_plan_pinning);
+
+    // Prefilters
+    RUN_TEST(test_literal_prefix_skip);
+    RUN_TEST(test_first_byte_scan);
+    RUN_TEST(test_required_literal);
+    RUN_TEST(test_multi_literal_prefilter);
+    RUN_TEST(test_case_insensitive_prefilter);
+
     int result = UNITY_END();
     
     // Run benchmark tests after main tests
@@ -0,0 +1,53 @@
+#include "test_shared.h"
+
+// The capture engines regex_exec is checked under: the plan, then the
+// backtracking VM and the Pike VM pinned to run alone from every start
+static const RegexMatcher test_matchers[] = {REGEX_MATCHER_NONE, REGEX_MATCHER_BACKTRACK, REGEX_MATCHER_PIKE};
+
+// The match starts at index (-1 for none) and its first group_count groups
+// are groups
+static void assert_exec_pinned(RegExp *re, const char *text, int index, const char **groups, int group_count) {
+    RegexMatcher pinned = re->compiled->pinned;
+    int last_index = re->last_index;
+
+    for (int i = 0; i < (int)(sizeof(test_matchers) / sizeof(test_matchers[0])); i++) {
+        TEST_ASSERT_TRUE(regex_pin_matcher(re->compiled, test_matchers[i]));
+        re->last_index = last_index;
+        MatchResult *result = regex_exec(re, text);
+        if (index < 0) {
+            TEST_ASSERT_NULL_MESSAGE(result, re->pattern);
+            continue;
+        }
+
+        TEST_ASSERT_NOT_NULL_MESSAGE(result, re->pattern);
+        TEST_ASSERT_EQUAL_INT_MESSAGE(index, result->index, re->pattern);
+        TEST_ASSERT_EQUAL_INT_MESSAGE(re->compiled->group_count, result->group_count, re->pattern);
+        for (int g = 0; g < group_count; g++) {
+            if (groups[g]) {
+                TEST_ASSERT_EQUAL_STRING_MESSAGE(groups[g], result->groups[g], re->pattern);
+            } else {
+                TEST_ASSERT_NULL_MESSAGE(result->groups[g], re->pattern);
+            }
+        }
+        match_result_free(result);
+    }
+    regex_pin_matcher(re->compiled, pinned);
+}
+
+void assert_exec_each_engine(RegExp *re, const char *text, int index, const char *match) {
+    assert_exec_pinned(re, text, index, &match, match ? 1 : 0);
+}
+
+void assert_groups_each_engine(RegExp *re, const char *text, int index, const char **groups) {
+    assert_exec_pinned(re, text, index, groups, re->compiled->group_count);
+}
+
+void block_edge_text(char *text, int size, const char *miss, int miss_step, const char *needle, int at) {
+    memset(text, '-', size - 1);
+    text[size - 1] = '\0';
+    if (miss) {
+        int length = (int)strlen(miss);
+        for (int offset = 0; offset + length < size; offset += miss_step) memcpy(text + offset, miss, length);
+    }
+    if (needle) memcpy(text + at, needle, strlen(needle));
+}
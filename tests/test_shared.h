@@ -49,6 +49,21 @@
     regex_free(re); \
 } while(0)
 
+// regex_exec under each capture engine in turn, from the same last_index:
+// the match starts at index (-1 for none) and, unless match is NULL, is
+// match.  last_index is left where the last engine put it.
+void assert_exec_each_engine(RegExp *re, const char *text, int index, const char *match);
+
+// The same, checking every group of the pattern against groups (NULL for
+// one that did not participate)
+void assert_groups_each_engine(RegExp *re, const char *text, int index, const char **groups);
+
+// size bytes of '-' and a terminator, with miss copied in every miss_step
+// bytes and then needle at offset at, each unless NULL.  Stepping at across
+// the text puts hits on both sides of every 16, 32 and 64 byte block the
+// SIMD scanners read.
+void block_edge_text(char *text, int size, const char *miss, int miss_step, const char *needle, int at);
+
 // Unity setup/teardown functions
 void setUp(void);
 void tearDown(void);
@@ -0,0 +1,38 @@
+#include "test_shared.h"
+
+void test_substring_search(void) {
+    // A pattern that is one literal is a string search, in either case under
+    // i; the near misses agree on the first and last bytes
+    const char *patterns[] = {"disk full", "Disk FULL", "\xe9t\xe9", "q"};
+    const char *flags[] = {"", "i", "", "i"};
+    const char *needles[] = {"disk full", "DISK full", "\xe9t\xe9", "Q"};
+
+    char text[300];
+    for (int i = 0; i < 4; i++) {
+        RegExp *re = regex_new(patterns[i], flags[i]);
+        TEST_ASSERT_EQUAL_INT(REGEX_MATCHER_SUBSTRING, re->compiled->plan.exec);
+
+        for (int at = 0; at + (int)strlen(needles[i]) < (int)sizeof(text); at += 3) {
+            block_edge_text(text, sizeof(text), "dISK fULx", 13, needles[i], at);
+            TEST_ASSERT_TRUE(regex_test(re, text));
+            assert_exec_each_engine(re, text, at, needles[i]);
+        }
+        regex_free(re);
+    }
+
+    // last_index moves past each occurrence, and wraps to 0 after the last
+    RegExp *re = regex_new("ab", "gi");
+    int indexes[] = {1, 3, 7};
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < 3; i++) {
+            MatchResult *result = regex_exec(re, "xabAbaaABx");
+            TEST_ASSERT_NOT_NULL(result);
+            TEST_ASSERT_EQUAL_INT(indexes[i], result->index);
+            TEST_ASSERT_EQUAL_INT(indexes[i] + 2, re->last_index);
+            match_result_free(result);
+        }
+        TEST_ASSERT_NULL(regex_exec(re, "xabAbaaABx"));
+        TEST_ASSERT_EQUAL_INT(0, re->last_index);
+    }
+    regex_free(re);
+}
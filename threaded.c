@@ -0,0 +1,333 @@
+// ================================================================
+// THREADED - Direct-threaded dispatch for the backtracking VM
+// ================================================================
+// This file is amalgamated into regex.c - do not compile separately
+//
+// Same semantics as execute(), but dispatched with computed goto through a
+// handler table, keeping pc/pos/last_operation_success in locals and
+// syncing the VM only around choice points.  threaded_build translates the
+// program once per CompiledRegex into per-pc handler codes, fusing common
+// sequences without renumbering (every pc keeps a handler of its own, so
+// jumps into the middle of a fused sequence still work):
+//
+//   CHAR CHAR ...             one length check and memcmp for the whole run
+//   CHOICE SAVE_POINTER       the * loop head; SAVE_POINTER only feeds
+//                             RESTORE_POSITION, so it is skipped without one
+//   CHARSET CHOICE BRANCH     the + loop, run as a tight greedy scan that
+//                             still pushes one choice point per byte
+//
+// Every consuming instruction also gets its 256-bit byte set, so flags are
+// resolved at build time instead of on each byte.
+
+#if defined(__GNUC__) && !defined(REGEX_NO_THREADED_DISPATCH)
+#define REGEX_THREADED_DISPATCH 1
+
+enum {
+    THREAD_CHAR,           // Exact byte
+    THREAD_CHAR_RUN,       // arg = run length of exact bytes starting here
+    THREAD_SET,            // CHARSET, DOT or case-folded CHAR via the byte set
+    THREAD_PLUS,           // Consuming pc, CHOICE +2, BRANCH -2
+    THREAD_CHOICE,         // arg = alternative pc
+    THREAD_CHOICE_SKIP,    // CHOICE followed by an inert SAVE_POINTER
+    THREAD_BRANCH,         // arg = target pc
+    THREAD_BRANCH_IF_NOT,  // arg = target pc
+    THREAD_NOP,            // ZERO_LENGTH, or SAVE_POINTER without RESTORE_POSITION
+    THREAD_SAVE_POINTER,
+    THREAD_RESTORE_POSITION,
+    THREAD_SAVE_GROUP,
+    THREAD_ANCHOR_START,
+    THREAD_ANCHOR_END,
+    THREAD_WORD_BOUNDARY,
+    THREAD_WORD_BOUNDARY_NEG,
+    THREAD_MATCH,
+    THREAD_FAIL
+};
+
+typedef struct ThreadedCode {
+    uint8_t *ops;            // Handler per pc
+    int *args;               // Per-pc operand, see above
+    char *chars;             // OP_CHAR byte per pc, so runs can be compared in one go
+    uint8_t (*sets)[32];     // Byte set per consuming pc
+} ThreadedCode;
+
+static void threaded_free(ThreadedCode *tc) {
+    if (!tc) return;
+    free(tc->ops);
+    free(tc->args);
+    free(tc->chars);
+    free(tc->sets);
+    free(tc);
+}
+
+static ThreadedCode* threaded_build(CompiledRegex *compiled) {
+    int code_len = compiled->code_len;
+    if (code_len == 0) return NULL;
+
+    ThreadedCode *tc = malloc(sizeof(ThreadedCode));
+    tc->ops = malloc(code_len);
+    tc->args = calloc(code_len, sizeof(int));
+    tc->chars = calloc(code_len, 1);
+    tc->sets = calloc(code_len, sizeof(*tc->sets));
+
+    int restores = 0;
+    for (int pc = 0; pc < code_len; pc++) {
+        if (compiled->code[pc].op == OP_RESTORE_POSITION) restores = 1;
+    }
+
+    // Backwards, so each CHAR knows the length of the run that follows it
+    for (int pc = code_len - 1; pc >= 0; pc--) {
+        Instruction *inst = &compiled->code[pc];
+        Instruction *next = pc + 1 < code_len ? &compiled->code[pc + 1] : NULL;
+
+        switch (inst->op) {
+            case OP_CHAR:
+            case OP_DOT:
+            case OP_CHARSET: {
+                inst_byte_set(compiled, inst, tc->sets[pc]);
+                int exact = inst->op == OP_CHAR && !((compiled->flags & 2) && isalpha((unsigned char)inst->c));
+                tc->ops[pc] = exact ? THREAD_CHAR : THREAD_SET;
+                tc->chars[pc] = inst->c;
+                tc->args[pc] = 1;
+
+                if (exact && next && tc->ops[pc + 1] <= THREAD_CHAR_RUN && next->op == OP_CHAR) {
+                    tc->ops[pc] = THREAD_CHAR_RUN;
+                    tc->args[pc] = tc->args[pc + 1] + 1;
+                }
+                if (pc + 2 < code_len && next->op == OP_CHOICE && next->addr == 2 &&
+                    compiled->code[pc + 2].op == OP_BRANCH && compiled->code[pc + 2].addr == -2) {
+                    tc->ops[pc] = THREAD_PLUS;
+                }
+                break;
+            }
+
+            case OP_CHOICE:
+                tc->ops[pc] = next && next->op == OP_SAVE_POINTER && !restores ? THREAD_CHOICE_SKIP : THREAD_CHOICE;
+                tc->args[pc] = pc + inst->addr;
+                break;
+
+            case OP_BRANCH:
+                tc->ops[pc] = THREAD_BRANCH;
+                tc->args[pc] = pc + inst->addr;
+                break;
+
+            case OP_BRANCH_IF_NOT:
+                tc->ops[pc] = THREAD_BRANCH_IF_NOT;
+                tc->args[pc] = pc + inst->addr;
+                break;
+
+            case OP_SAVE_POINTER:
+                tc->ops[pc] = restores ? THREAD_SAVE_POINTER : THREAD_NOP;
+                break;
+
+            case OP_RESTORE_POSITION: tc->ops[pc] = THREAD_RESTORE_POSITION; break;
+            case OP_SAVE_GROUP: tc->ops[pc] = THREAD_SAVE_GROUP; break;
+            case OP_ANCHOR_START: tc->ops[pc] = THREAD_ANCHOR_START; break;
+            case OP_ANCHOR_END: tc->ops[pc] = THREAD_ANCHOR_END; break;
+            case OP_WORD_BOUNDARY: tc->ops[pc] = THREAD_WORD_BOUNDARY; break;
+            case OP_WORD_BOUNDARY_NEG: tc->ops[pc] = THREAD_WORD_BOUNDARY_NEG; break;
+            case OP_MATCH: tc->ops[pc] = THREAD_MATCH; break;
+            case OP_FAIL: tc->ops[pc] = THREAD_FAIL; break;
+            default: tc->ops[pc] = THREAD_NOP; break;  // ZERO_LENGTH
+        }
+    }
+
+    return tc;
+}
+
+#define THREAD_IN_SET(set, c) (((set)[(unsigned char)(c) >> 3] >> ((unsigned char)(c) & 7)) & 1)
+
+// Threaded equivalent of execute().  Requires a visited set: it bounds the
+// work, so there is no instruction limit to count against.
+static int execute_threaded(CompiledRegex *compiled, VM *vm) {
+    static const void *handlers[] = {
+        [THREAD_CHAR] = &&do_char,
+        [THREAD_CHAR_RUN] = &&do_char_run,
+        [THREAD_SET] = &&do_set,
+        [THREAD_PLUS] = &&do_plus,
+        [THREAD_CHOICE] = &&do_choice,
+        [THREAD_CHOICE_SKIP] = &&do_choice,
+        [THREAD_BRANCH] = &&do_branch,
+        [THREAD_BRANCH_IF_NOT] = &&do_branch_if_not,
+        [THREAD_NOP] = &&do_nop,
+        [THREAD_SAVE_POINTER] = &&do_save_pointer,
+        [THREAD_RESTORE_POSITION] = &&do_restore_position,
+        [THREAD_SAVE_GROUP] = &&do_save_group,
+        [THREAD_ANCHOR_START] = &&do_anchor_start,
+        [THREAD_ANCHOR_END] = &&do_anchor_end,
+        [THREAD_WORD_BOUNDARY] = &&do_word_boundary,
+        [THREAD_WORD_BOUNDARY_NEG] = &&do_word_boundary,
+        [THREAD_MATCH] = &&do_match,
+        [THREAD_FAIL] = &&do_fail
+    };
+
+    ThreadedCode *tc = compiled->threaded;
+    Instruction *code = compiled->code;
+    const char *text = vm->text;
+    int text_len = vm->text_len;
+    int flags = vm->flags;
+    uint8_t *visited = vm->visited;
+
+    int pc = vm->pc;
+    int pos = vm->pos;
+    int los = vm->last_operation_success;
+
+#define DISPATCH() goto *handlers[tc->ops[pc]]
+
+// Choice points read pos and last_operation_success from the VM
+#define SYNC() do { vm->pos = pos; vm->last_operation_success = los; } while (0)
+
+#define VISIT(choice_pc, success) do { \
+    if (visited) { \
+        int bit_ = (((choice_pc) * (text_len + 1) + pos) << 1) | (success); \
+        if (visited[bit_ >> 3] & (1 << (bit_ & 7))) goto do_fail; \
+        visited[bit_ >> 3] |= 1 << (bit_ & 7); \
+    } else if (vm_visit(vm, (choice_pc), pos, (success))) { \
+        goto do_fail; \
+    } \
+} while (0)
+
+    DISPATCH();
+
+do_char:
+    if (pos >= text_len || text[pos] != tc->chars[pc]) goto do_fail;
+    pos++;
+    pc++;
+    los = 1;
+    DISPATCH();
+
+do_char_run: {
+    int length = tc->args[pc];
+    if (text_len - pos < length || memcmp(text + pos, tc->chars + pc, length) != 0) goto do_fail;
+    pos += length;
+    pc += length;
+    los = 1;
+    DISPATCH();
+}
+
+do_set:
+    if (pos >= text_len || !THREAD_IN_SET(tc->sets[pc], text[pos])) goto do_fail;
+    pos++;
+    pc++;
+    los = 1;
+    DISPATCH();
+
+do_plus: {
+    // pc: consuming instruction, pc + 1: CHOICE +2, pc + 2: BRANCH back to pc
+    const uint8_t *set = tc->sets[pc];
+    int choice_pc = pc + 1;
+    if (pos >= text_len || !THREAD_IN_SET(set, text[pos])) goto do_fail;
+    for (;;) {
+        pos++;
+        los = 1;
+        VISIT(choice_pc, 1);
+        if (pos < text_len && THREAD_IN_SET(set, text[pos])) {
+            SYNC();
+            push_choice(vm, choice_pc + 2);
+            continue;
+        }
+        // The next byte would fail and pop the choice just made: take the
+        // exit directly, leaving the VM as that pop would
+        vm->choice_count++;
+        pc = choice_pc + 2;
+        DISPATCH();
+    }
+}
+
+do_choice:
+    VISIT(pc, los != 0);
+    SYNC();
+    push_choice(vm, tc->args[pc]);
+    pc += tc->ops[pc] == THREAD_CHOICE_SKIP ? 2 : 1;
+    DISPATCH();
+
+do_branch:
+    pc = tc->args[pc];
+    DISPATCH();
+
+do_branch_if_not:
+    pc = los ? tc->args[pc] : pc + 1;
+    DISPATCH();
+
+do_nop:
+    pc++;
+    DISPATCH();
+
+do_save_pointer:
+    vm_push_position(vm, pos);
+    pc++;
+    DISPATCH();
+
+do_restore_position:
+    pos = vm_pop_position(vm);
+    pc++;
+    DISPATCH();
+
+do_save_group:
+    vm_save_group(vm, code[pc].group_num, code[pc].is_end, pos);
+    pc++;
+    DISPATCH();
+
+do_anchor_start:
+    if (pos != 0 && !((flags & 8) && text[pos - 1] == '\n')) goto do_fail;
+    pc++;
+    los = 1;
+    DISPATCH();
+
+do_anchor_end:
+    if (pos != text_len && !((flags & 8) && text[pos] == '\n')) goto do_fail;
+    pc++;
+    los = 1;
+    DISPATCH();
+
+do_word_boundary: {
+    int left_is_word = pos > 0 && is_word_char(text[pos - 1]);
+    int right_is_word = pos < text_len && is_word_char(text[pos]);
+    int want_boundary = tc->ops[pc] == THREAD_WORD_BOUNDARY;
+    if ((left_is_word != right_is_word) != want_boundary) goto do_fail;
+    pc++;
+    los = 1;
+    DISPATCH();
+}
+
+do_match:
+    vm->pc = pc;
+    SYNC();
+    return 1;
+
+do_fail:
+    // pop_choice restores pc, pos and last_operation_success
+    if (!pop_choice(vm)) return 0;
+    pc = vm->pc;
+    pos = vm->pos;
+    los = vm->last_operation_success;
+    DISPATCH();
+
+#undef DISPATCH
+#undef SYNC
+#undef VISIT
+}
+
+#else
+
+struct ThreadedCode {
+    int unused;
+};
+
+static void threaded_free(struct ThreadedCode *tc) {
+    (void)tc;
+}
+
+static struct ThreadedCode* threaded_build(CompiledRegex *compiled) {
+    (void)compiled;
+    return NULL;
+}
+
+#endif
+
+// Run the backtracking VM for one start position
+static int run_backtracker(CompiledRegex *compiled, VM *vm) {
+#ifdef REGEX_THREADED_DISPATCH
+    if (compiled->threaded && (vm->visited || vm->visited_blocks)) return execute_threaded(compiled, vm);
+#endif
+    return execute(compiled, vm);
+}